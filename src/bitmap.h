@@ -0,0 +1,297 @@
+#ifndef __BITMAP_H
+#define __BITMAP_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define WORD_BITS 64
+#define FULL_WORD (~0ul)
+
+/**
+ * @brief  Struct used to represent SIZE units of memory with one bit
+ *         per unit that is set while the unit is used. The units are
+ *         packed in 64 bit words so a whole word is checked at once.
+ *         On top of the words there is a summary level with one bit per
+ *         word, bit i of FULL is set while word i is all used and bit i
+ *         of ANY is set while word i has any used unit, so a search can
+ *         skip 64 words at a time when looking for a free or a used unit.
+ *         STEPS counts the words its searches read.
+ */
+typedef struct BitMap {
+  unsigned long *words;
+  unsigned long *full;
+  unsigned long *any;
+  long size;
+  long wordCount;
+  long summaryCount;
+  long steps;
+} BitMap;
+
+/**
+ * @brief  Creates and returns a new bit map of SIZE free units.
+ *
+ * @param  SIZE number of units.
+ */
+BitMap* newBitMap(long size) {
+  BitMap *bitMap = (BitMap *)malloc(sizeof(BitMap));
+  bitMap->size = size;
+  bitMap->wordCount = (size + WORD_BITS - 1) / WORD_BITS;
+  bitMap->summaryCount = (bitMap->wordCount + WORD_BITS - 1) / WORD_BITS;
+  bitMap->steps = 0;
+  bitMap->words = (unsigned long *)calloc(bitMap->wordCount,
+                                          sizeof(unsigned long));
+  bitMap->full = (unsigned long *)calloc(bitMap->summaryCount,
+                                         sizeof(unsigned long));
+  bitMap->any = (unsigned long *)calloc(bitMap->summaryCount,
+                                        sizeof(unsigned long));
+
+  // the units after the end of the last word are always used
+  // so a free run never goes past the end of the memory
+  if (size % WORD_BITS) {
+    long last = bitMap->wordCount - 1;
+    bitMap->words[last] = FULL_WORD << (size % WORD_BITS);
+    bitMap->any[last / WORD_BITS] |= 1ul << (last % WORD_BITS);
+  }
+  return bitMap;
+}
+
+/**
+ * @brief  Frees the bit map.
+ *
+ * @param  BIT_MAP the bit map to be freed.
+ */
+void deleteBitMap(BitMap *bitMap) {
+  free(bitMap->words);
+  free(bitMap->full);
+  free(bitMap->any);
+  free(bitMap);
+}
+
+/**
+ * @brief  Updates the summary bits of word I after it changed.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  I index of the word.
+ */
+void summarizeBM(BitMap *bitMap, long i) {
+  unsigned long bit = 1ul << (i % WORD_BITS);
+  if (bitMap->words[i] == FULL_WORD) {
+    bitMap->full[i / WORD_BITS] |= bit;
+  } else {
+    bitMap->full[i / WORD_BITS] &= ~bit;
+  }
+  if (bitMap->words[i]) {
+    bitMap->any[i / WORD_BITS] |= bit;
+  } else {
+    bitMap->any[i / WORD_BITS] &= ~bit;
+  }
+}
+
+/**
+ * @brief  Returns the index of the first word from word FROM on whose
+ *         bit in SUMMARY is set, or -1 if there's none. With INVERT
+ *         it looks for a cleared bit instead.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  SUMMARY one of the summary levels of the bit map.
+ * @param  FROM index of the first word to look at.
+ * @param  INVERT whether to look for a cleared bit.
+ */
+long nextWordBM(BitMap *bitMap, unsigned long *summary, long from,
+                bool invert) {
+  unsigned long flip = invert ? FULL_WORD : 0;
+  long i = from / WORD_BITS;
+  if (i >= bitMap->summaryCount) {
+    return -1;
+  }
+
+  unsigned long bits = (summary[i] ^ flip) & (FULL_WORD << (from % WORD_BITS));
+  bitMap->steps += 1;
+  while (!bits) {
+    i += 1;
+#ifdef __AVX2__
+    // skip four summary words at a time while none of them has a match
+    __m256i flips = _mm256_set1_epi64x((long)flip);
+    while (i + 4 <= bitMap->summaryCount) {
+      __m256i block = _mm256_loadu_si256((__m256i *)(summary + i));
+      if (!_mm256_testz_si256(_mm256_xor_si256(block, flips),
+                              _mm256_set1_epi64x(-1))) {
+        break;
+      }
+      i += 4;
+      bitMap->steps += 1;
+    }
+#endif
+    if (i >= bitMap->summaryCount) {
+      return -1;
+    }
+    bits = summary[i] ^ flip;
+    bitMap->steps += 1;
+  }
+
+  long word = i * WORD_BITS + __builtin_ctzl(bits);
+  return word < bitMap->wordCount ? word : -1;
+}
+
+/**
+ * @brief  Returns the first unit from FROM on that is used when USED
+ *         is True or free otherwise, or the size of the memory if
+ *         there's none.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  FROM first unit to look at.
+ * @param  USED whether to look for a used unit.
+ */
+long nextUnitBM(BitMap *bitMap, long from, bool used) {
+  if (from >= bitMap->size) {
+    return bitMap->size;
+  }
+
+  unsigned long flip = used ? 0 : FULL_WORD;
+  long i = from / WORD_BITS;
+  unsigned long bits = (bitMap->words[i] ^ flip) &
+                       (FULL_WORD << (from % WORD_BITS));
+  bitMap->steps += 1;
+  if (!bits) {
+    // a used unit is in a word that has any, a free one in a word
+    // that isn't full, the summary finds the next such word
+    i = used ? nextWordBM(bitMap, bitMap->any, i + 1, false)
+             : nextWordBM(bitMap, bitMap->full, i + 1, true);
+    if (i == -1) {
+      return bitMap->size;
+    }
+    bits = bitMap->words[i] ^ flip;
+    bitMap->steps += 1;
+  }
+
+  long unit = i * WORD_BITS + __builtin_ctzl(bits);
+  return unit < bitMap->size ? unit : bitMap->size;
+}
+
+/**
+ * @brief  Returns the first used unit among the SIZE units from START
+ *         on, or START + SIZE if they're all free. It only reads the
+ *         words that cover those units.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  START first unit to look at.
+ * @param  SIZE number of units.
+ */
+long usedInBM(BitMap *bitMap, long start, long size) {
+  long end = start + size;
+  long last = (end - 1) / WORD_BITS;
+
+  for (long i = start / WORD_BITS; i <= last; ++i) {
+    unsigned long bits = bitMap->words[i];
+    bitMap->steps += 1;
+    if (i == start / WORD_BITS) {
+      bits &= FULL_WORD << (start % WORD_BITS);
+    }
+    if (bits) {
+      long unit = i * WORD_BITS + __builtin_ctzl(bits);
+      return unit < end ? unit : end;
+    }
+  }
+  return end;
+}
+
+/**
+ * @brief  Returns the start of the first run of SIZE free units that
+ *         starts from FROM on, or -1 if there's none.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  FROM first unit the run can start at.
+ * @param  SIZE number of units.
+ */
+long fitBM(BitMap *bitMap, long from, long size) {
+  long start = nextUnitBM(bitMap, from, false);
+  while (start + size <= bitMap->size) {
+    // only the units the run needs are checked, not the whole hole
+    long used = usedInBM(bitMap, start, size);
+    if (used == start + size) {
+      return start;
+    }
+    start = nextUnitBM(bitMap, used, false);
+  }
+  return -1;
+}
+
+/**
+ * @brief  Returns the length of the longest run of free units. It goes
+ *         through every run, skipping whole words of used units with
+ *         the summary, and counts the words it reads as steps.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ */
+long largestRunBM(BitMap *bitMap) {
+  long largest = 0;
+  long start = nextUnitBM(bitMap, 0, false);
+  while (start < bitMap->size) {
+    long end = nextUnitBM(bitMap, start, true);
+    if (end - start > largest) {
+      largest = end - start;
+    }
+    start = nextUnitBM(bitMap, end, false);
+  }
+  return largest;
+}
+
+/**
+ * @brief  Returns the number of runs of free units and sets LARGEST
+ *         to the length of the longest one. It doesn't count as steps.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  LARGEST pointer to where the longest length goes.
+ */
+long runsBM(BitMap *bitMap, long *largest) {
+  long steps = bitMap->steps;
+  long runs = 0;
+  *largest = 0;
+  long start = nextUnitBM(bitMap, 0, false);
+  while (start < bitMap->size) {
+    long end = nextUnitBM(bitMap, start, true);
+    if (end - start > *largest) {
+      *largest = end - start;
+    }
+    runs += 1;
+    start = nextUnitBM(bitMap, end, false);
+  }
+  bitMap->steps = steps;
+  return runs;
+}
+
+/**
+ * @brief  Marks the SIZE units from START on as used or free.
+ *
+ * @param  BIT_MAP pointer to the bit map.
+ * @param  START first unit.
+ * @param  SIZE number of units.
+ * @param  USED whether the units become used.
+ */
+void markBM(BitMap *bitMap, long start, long size, bool used) {
+  long end = start + size;
+  long first = start / WORD_BITS;
+  long last = (end - 1) / WORD_BITS;
+
+  for (long i = first; i <= last; ++i) {
+    unsigned long mask = FULL_WORD;
+    if (i == first) {
+      mask &= FULL_WORD << (start % WORD_BITS);
+    }
+    if (i == last && end % WORD_BITS) {
+      mask &= FULL_WORD >> (WORD_BITS - end % WORD_BITS);
+    }
+    if (used) {
+      bitMap->words[i] |= mask;
+    } else {
+      bitMap->words[i] &= ~mask;
+    }
+    summarizeBM(bitMap, i);
+  }
+}
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef __BUDDY_H
+#define __BUDDY_H
+
+#include "hash_map.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * @brief  Struct used to represent one free block of a buddy system,
+ *         NEXT and PREV are the starts of the free blocks around it
+ *         in the free list of its order or -1.
+ */
+typedef struct BuddyBlock {
+  long next;
+  long prev;
+  int order;
+} BuddyBlock;
+
+/**
+ * @brief  Struct used to represent a buddy system over SIZE units
+ *         of memory. A free block of order k is 2^k units long and
+ *         starts at a multiple of 2^k, so its buddy starts at
+ *         start ^ 2^k. Free blocks of each order are kept in their
+ *         own doubly linked list that starts at HEADS, and BLOCKS maps
+ *         the start of every free block to it, so the system takes
+ *         memory for its free blocks only and not for every unit.
+ *         Bit k of NON_EMPTY is set while there are free blocks of order k.
+ *         STEPS counts the blocks allocations went through.
+ */
+typedef struct Buddy {
+  long size;
+  int orders;
+  long *heads;
+  HashMap *blocks;
+  unsigned long nonEmpty;
+  long steps;
+} Buddy;
+
+/**
+ * @brief  Returns the smallest power of two not less than NUM.
+ *
+ * @param  NUM a positive integer.
+ */
+long ceilPowerOfTwo(long num) {
+  return num <= 1 ? 1 : 1l << (64 - __builtin_clzl(num - 1));
+}
+
+/**
+ * @brief  Returns the order of the smallest block that fits SIZE units.
+ *
+ * @param  SIZE number of units.
+ */
+int orderBuddy(long size) {
+  return __builtin_ctzl(ceilPowerOfTwo(size));
+}
+
+/**
+ * @brief  Adds the free block at START of order ORDER to its free list.
+ *
+ * @param  BUDDY pointer to the buddy system.
+ * @param  START start of the block.
+ * @param  ORDER order of the block.
+ */
+void pushBuddy(Buddy *buddy, long start, int order) {
+  long head = buddy->heads[order];
+  if (head != -1) {
+    ((BuddyBlock *)getHM(buddy->blocks, head))->prev = start;
+  }
+  BuddyBlock block;
+  block.next = head;
+  block.prev = -1;
+  block.order = order;
+  putHM(buddy->blocks, start, &block);
+  buddy->heads[order] = start;
+  buddy->nonEmpty |= 1ul << order;
+}
+
+/**
+ * @brief  Takes the free block at START out of its free list.
+ *
+ * @param  BUDDY pointer to the buddy system.
+ * @param  START start of the block.
+ */
+void unlinkBuddy(Buddy *buddy, long start) {
+  BuddyBlock block = *(BuddyBlock *)getHM(buddy->blocks, start);
+  if (block.prev != -1) {
+    ((BuddyBlock *)getHM(buddy->blocks, block.prev))->next = block.next;
+  } else {
+    buddy->heads[block.order] = block.next;
+  }
+  if (block.next != -1) {
+    ((BuddyBlock *)getHM(buddy->blocks, block.next))->prev = block.prev;
+  }
+  removeHM(buddy->blocks, start);
+  if (buddy->heads[block.order] == -1) {
+    buddy->nonEmpty &= ~(1ul << block.order);
+  }
+}
+
+/**
+ * @brief  Creates and returns a new buddy system
+ *         with SIZE free units of memory.
+ *
+ * @param  SIZE number of units, a size that isn't a power of two
+ *         starts as one free block for each bit set in it.
+ */
+Buddy* newBuddy(long size) {
+  Buddy *buddy = (Buddy *)malloc(sizeof(Buddy));
+  buddy->size = size;
+  buddy->orders = 64 - __builtin_clzl(size);
+  buddy->heads = (long *)malloc(buddy->orders * sizeof(long));
+  buddy->blocks = newHashMap(sizeof(BuddyBlock));
+  buddy->nonEmpty = 0;
+  buddy->steps = 0;
+  for (int i = 0; i < buddy->orders; ++i) {
+    buddy->heads[i] = -1;
+  }
+
+  // bigger blocks go first so every block starts at a multiple of its size
+  long start = 0;
+  for (int i = buddy->orders - 1; i >= 0; --i) {
+    if (size & (1l << i)) {
+      pushBuddy(buddy, start, i);
+      start += 1l << i;
+    }
+  }
+  return buddy;
+}
+
+/**
+ * @brief  Frees the buddy system.
+ *
+ * @param  BUDDY the buddy system to be freed.
+ */
+void deleteBuddy(Buddy *buddy) {
+  free(buddy->heads);
+  deleteHashMap(buddy->blocks);
+  free(buddy);
+}
+
+/**
+ * @brief  Allocates the smallest block that fits SIZE units and returns
+ *         its start, or -1 if there's no free block big enough.
+ *         A bigger block is split in halves until it fits, the upper
+ *         halves are left free.
+ *
+ * @param  BUDDY pointer to the buddy system.
+ * @param  SIZE number of units.
+ */
+long allocateBuddy(Buddy *buddy, long size) {
+  int order = orderBuddy(size);
+  if (order >= buddy->orders) {
+    return -1;
+  }
+
+  // the smallest order that has a free block
+  unsigned long fits = buddy->nonEmpty >> order;
+  if (!fits) {
+    return -1;
+  }
+  int found = order + __builtin_ctzl(fits);
+
+  long start = buddy->heads[found];
+  unlinkBuddy(buddy, start);
+  buddy->steps += 1;
+  while (found > order) {
+    found -= 1;
+    buddy->steps += 1;
+    pushBuddy(buddy, start + (1l << found), found);
+  }
+  return start;
+}
+
+/**
+ * @brief  Frees the block at START that was allocated for SIZE units,
+ *         merging it with its buddy as long as the buddy is free.
+ *
+ * @param  BUDDY pointer to the buddy system.
+ * @param  START start of the block.
+ * @param  SIZE number of units it was allocated for.
+ */
+void freeBuddy(Buddy *buddy, long start, long size) {
+  int order = orderBuddy(size);
+  while (order + 1 < buddy->orders) {
+    long other = start ^ (1l << order);
+    BuddyBlock *block = (BuddyBlock *)getHM(buddy->blocks, other);
+    if (block == NULL || block->order != order) {
+      break;
+    }
+    unlinkBuddy(buddy, other);
+    start &= ~(1l << order);
+    order += 1;
+  }
+  pushBuddy(buddy, start, order);
+}
+
+#endif
@@ -7,12 +7,15 @@
 #include <string.h>
 
 /**
- * @brief  Struct used to represent a circular collection of elements
+ * @brief  Struct used to represent a circular collection of elements.
+ *         Its nodes come from its own pool so they are
+ *         recycled instead of being freed and allocated again.
  */
 typedef struct CircularQueue {
   Node *head;
   size_t size;
   int length;
+  Pool pool;
 } CircularQueue;
 
 /**
@@ -26,6 +29,7 @@ CircularQueue* newCircularQueue(size_t size) {
   circularQueue->head = NULL;
   circularQueue->size = size;
   circularQueue->length = 0;
+  initNodePool(&circularQueue->pool, size);
   return circularQueue;
 }
 
@@ -35,13 +39,7 @@ CircularQueue* newCircularQueue(size_t size) {
  * @param  CIRCULAR_QUEUE the circular queue to be freed.
  */
 void deleteCircularQueue(CircularQueue *circularQueue) {
-  Node *node = circularQueue->head;
-  for (int i = 0; i < circularQueue->length; ++i) {
-    Node *prev = node;
-    node = node->next;
-    free(prev->data);
-    free(prev);
-  }
+  clearPool(&circularQueue->pool);
   free(circularQueue);
 }
 
@@ -53,10 +51,7 @@ void deleteCircularQueue(CircularQueue *circularQueue) {
  * @param  DATA pointer to the data to be inserted.
  */
 void enqueueCQ(CircularQueue *circularQueue, void *data) {
-  Node *node = (Node *)malloc(sizeof(Node));
-  node->data = malloc(circularQueue->size);
-
-  memcpy(node->data, data, circularQueue->size);
+  Node *node = allocateNode(&circularQueue->pool, data, circularQueue->size);
 
   if (circularQueue->head == NULL) {
     node->next = node;
@@ -94,7 +89,7 @@ bool removeCQ(CircularQueue *circularQueue) {
 
   circularQueue->length -= 1;
 
-  free(node);
+  releasePool(&circularQueue->pool, node);
   return true;
 }
 
@@ -192,4 +187,66 @@ bool movePrev(CircularQueue *circularQueue, void **data) {
   return peekCQ(circularQueue, data);
 }
 
+/**
+ * @brief  Returns a pointer to the head node data of a circular queue
+ *         or NULL if it's empty, without copying it.
+ *         The pointer is only valid until that node is removed.
+ *
+ * @param  CIRCULAR_QUEUE pointer to the circular queue.
+ */
+void* borrowCQ(CircularQueue *circularQueue) {
+  return circularQueue->head == NULL ? NULL : circularQueue->head->data;
+}
+
+/**
+ * @brief  Moves the head of the queue to the next node and returns
+ *         a pointer to the new head node data or NULL if it's empty,
+ *         without copying it.
+ *
+ * @param  CIRCULAR_QUEUE pointer to the circular queue.
+ */
+void* borrowNext(CircularQueue *circularQueue) {
+  if (circularQueue->head != NULL) {
+    circularQueue->head = circularQueue->head->next;
+  }
+  return borrowCQ(circularQueue);
+}
+
+/**
+ * @brief  Moves the head of the queue to the previous node and returns
+ *         a pointer to the new head node data or NULL if it's empty,
+ *         without copying it.
+ *
+ * @param  CIRCULAR_QUEUE pointer to the circular queue.
+ */
+void* borrowPrev(CircularQueue *circularQueue) {
+  if (circularQueue->head != NULL) {
+    circularQueue->head = circularQueue->head->prev;
+  }
+  return borrowCQ(circularQueue);
+}
+
+/**
+ * @brief  Loops once around a circular queue starting from the node
+ *         FIRST with NODE pointing to each node in turn.
+ *         The queue must not change inside the loop.
+ *
+ * @param  NODE name of the node pointer.
+ * @param  FIRST pointer to the node to start from or NULL for none.
+ */
+#define FOR_EACH_CQ_FROM(NODE, FIRST)                 \
+  for (Node *NODE = (FIRST); NODE != NULL;            \
+       NODE = (NODE->next == (FIRST)) ? NULL : NODE->next)
+
+/**
+ * @brief  Loops once around a circular queue starting from its head
+ *         with NODE pointing to each node in turn.
+ *         The queue must not change inside the loop.
+ *
+ * @param  NODE name of the node pointer.
+ * @param  CIRCULAR_QUEUE pointer to the circular queue.
+ */
+#define FOR_EACH_CQ(NODE, CIRCULAR_QUEUE) \
+  FOR_EACH_CQ_FROM(NODE, (CIRCULAR_QUEUE)->head)
+
 #endif
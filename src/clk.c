@@ -9,6 +9,8 @@
 
 int shmid;
 
+void tickVirtual();
+
 /* Clear the resources before exit */
 void cleanup(int signum) {
   shmctl(shmid, IPC_RMID, NULL);
@@ -20,21 +22,52 @@ void cleanup(int signum) {
 int main(int argc, char *argv[]) {
   printf("Clock Starting...\n");
   signal(SIGINT, cleanup);
+  parseOptions(argc, argv);
   int clk = 0;
-  // Create shared memory for one integer variable 4 bytes
-  shmid = shmget(SHKEY, 4, IPC_CREAT | 0644);
+  // Create shared memory for the clock and the tick barrier
+  shmid = shmget(SHKEY, sizeof(SharedClock), IPC_CREAT | 0644);
   if ((long)shmid == -1) {
     perror("Error in creating shm!");
     exit(-1);
   }
-  int *shmaddr = (int *)shmat(shmid, (void *)0, 0);
+  shmaddr = (int *)shmat(shmid, (void *)0, 0);
   if ((long)shmaddr == -1) {
     perror("Error in attaching the shm in clock!");
     exit(-1);
   }
+  sharedClock = (SharedClock *)shmaddr;
   *shmaddr = clk; /* Initialize shared memory */
+  if (options.virtualTime) {
+    tickVirtual();
+  }
   while (1) {
     usleep(CLOCK_TICK_DURATION);
-    (*shmaddr)++;
+    setClk(*shmaddr + 1);
+  }
+}
+
+/*
+ * Virtual time: instead of sleeping for a whole tick, wait until every
+ * participant is done with the current tick and then jump straight to
+ * the earliest tick any of them asked for. Once nobody needs another
+ * tick the simulation is marked as finished.
+ */
+void tickVirtual() {
+  while (1) {
+    int next = INT_MAX;
+    for (int i = 0; i < PARTICIPANT_COUNT; ++i) {
+      waitRelease(i, *shmaddr, 0);
+      if (sharedClock->next[i] < next) {
+        next = sharedClock->next[i];
+      }
+    }
+    if (next == INT_MAX) {
+      sharedClock->finished = true;
+      futexWake(&sharedClock->finished);
+      while (1) {
+        pause();
+      }
+    }
+    setClk((next > *shmaddr) ? next : *shmaddr + 1);
   }
 }
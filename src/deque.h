@@ -9,12 +9,15 @@
 /**
  * @brief  Struct used to represent a collection of elements
  *         that can be operated on from its front or its back.
+ *         Its nodes come from its own pool so they are
+ *         recycled instead of being freed and allocated again.
  */
 typedef struct Deque {
   Node *head;
   Node *tail;
   size_t size;
   int length;
+  Pool pool;
 } Deque;
 
 /**
@@ -29,6 +32,7 @@ Deque* newDeque(size_t size) {
   deque->tail = NULL;
   deque->size = size;
   deque->length = 0;
+  initNodePool(&deque->pool, size);
   return deque;
 }
 
@@ -38,13 +42,7 @@ Deque* newDeque(size_t size) {
  * @param  DEQUE the deque to be freed.
  */
 void deleteDeque(Deque *deque) {
-  Node *node = deque->head;
-  for (int i = 0; i < deque->length; ++i) {
-    Node *prev = node;
-    node = node->next;
-    free(prev->data);
-    free(prev);
-  }
+  clearPool(&deque->pool);
   free(deque);
 }
 
@@ -56,10 +54,7 @@ void deleteDeque(Deque *deque) {
  * @param  DATA pointer to the data to be inserted.
  */
 void pushFront(Deque *deque, void *data) {
-  Node *node = (Node *)malloc(sizeof(Node));
-  node->data = malloc(deque->size);
-
-  memcpy(node->data, data, deque->size);
+  Node *node = allocateNode(&deque->pool, data, deque->size);
 
   node->next = deque->head;
   node->prev = NULL;
@@ -84,10 +79,7 @@ void pushFront(Deque *deque, void *data) {
  * @param  DATA pointer to the data to be inserted.
  */
 void pushBack(Deque *deque, void *data) {
-  Node *node = (Node *)malloc(sizeof(Node));
-  node->data = malloc(deque->size);
-
-  memcpy(node->data, data, deque->size);
+  Node *node = allocateNode(&deque->pool, data, deque->size);
 
   node->next = NULL;
   node->prev = deque->tail;
@@ -129,7 +121,7 @@ bool removeFront(Deque *deque) {
     deque->tail = NULL;
   }
 
-  free(node);
+  releasePool(&deque->pool, node);
   return true;
 }
 
@@ -158,10 +150,31 @@ bool removeBack(Deque *deque) {
     deque->head = NULL;
   }
 
-  free(node);
+  releasePool(&deque->pool, node);
   return true;
 }
 
+/**
+ * @brief  Removes NODE from anywhere in a deque.
+ *
+ * @param  DEQUE pointer to the deque.
+ * @param  NODE a node of the deque.
+ */
+void removeNode(Deque *deque, Node *node) {
+  if (node->prev != NULL) {
+    node->prev->next = node->next;
+  } else {
+    deque->head = node->next;
+  }
+  if (node->next != NULL) {
+    node->next->prev = node->prev;
+  } else {
+    deque->tail = node->prev;
+  }
+  deque->length -= 1;
+  releasePool(&deque->pool, node);
+}
+
 /**
  * @brief  Removes the node at the front of a deque and
  *         returns True if there was a node to remove.
@@ -274,4 +287,37 @@ bool peekBack(Deque *deque, void **data) {
   return true;
 }
 
+/**
+ * @brief  Returns a pointer to the front node data of a deque
+ *         or NULL if it's empty, without copying it.
+ *         The pointer is only valid until that node is removed.
+ *
+ * @param  DEQUE pointer to the deque.
+ */
+void* borrowFront(Deque *deque) {
+  return deque->head == NULL ? NULL : deque->head->data;
+}
+
+/**
+ * @brief  Returns a pointer to the back node data of a deque
+ *         or NULL if it's empty, without copying it.
+ *         The pointer is only valid until that node is removed.
+ *
+ * @param  DEQUE pointer to the deque.
+ */
+void* borrowBack(Deque *deque) {
+  return deque->tail == NULL ? NULL : deque->tail->data;
+}
+
+/**
+ * @brief  Loops over the nodes of a deque from front to back
+ *         with NODE pointing to each of them in turn.
+ *         The deque must not change inside the loop.
+ *
+ * @param  NODE name of the node pointer.
+ * @param  DEQUE pointer to the deque.
+ */
+#define FOR_EACH_DEQUE(NODE, DEQUE) \
+  for (Node *NODE = (DEQUE)->head; NODE != NULL; NODE = NODE->next)
+
 #endif
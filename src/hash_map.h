@@ -0,0 +1,180 @@
+#ifndef __HASH_MAP_H
+#define __HASH_MAP_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_MAP_SIZE 64
+
+/**
+ * @brief  Struct used to represent a map from integer keys to values
+ *         with O(1) lookups. Entries are kept in one array with open
+ *         addressing, a key that collides goes to the next free slot
+ *         after its home slot. USED tells which slots hold an entry,
+ *         and the value of slot i starts at VALUES + i * SIZE.
+ */
+typedef struct HashMap {
+  long *keys;
+  bool *used;
+  char *values;
+  size_t size;
+  int length;
+  int capacity;
+} HashMap;
+
+/**
+ * @brief  Returns the home slot of KEY in a map of CAPACITY slots.
+ *
+ * @param  KEY the key.
+ * @param  CAPACITY number of slots, a power of two.
+ */
+int slotHM(long key, int capacity) {
+  // fibonacci hashing spreads keys that only differ in their low bits
+  unsigned long hash = (unsigned long)key * 0x9E3779B97F4A7C15ul;
+  return (int)(hash >> 32) & (capacity - 1);
+}
+
+/**
+ * @brief  Allocates empty slots for a map of CAPACITY slots.
+ *
+ * @param  HASH_MAP pointer to the map.
+ * @param  CAPACITY number of slots, a power of two.
+ */
+void initSlotsHM(HashMap *hashMap, int capacity) {
+  hashMap->keys = (long *)malloc(capacity * sizeof(long));
+  hashMap->used = (bool *)calloc(capacity, sizeof(bool));
+  hashMap->values = (char *)malloc(capacity * hashMap->size);
+  hashMap->capacity = capacity;
+}
+
+/**
+ * @brief  Creates and returns a new map
+ *         with values of size SIZE.
+ *
+ * @param  SIZE size of the values.
+ */
+HashMap* newHashMap(size_t size) {
+  HashMap *hashMap = (HashMap *)malloc(sizeof(HashMap));
+  hashMap->size = size;
+  hashMap->length = 0;
+  initSlotsHM(hashMap, HASH_MAP_SIZE);
+  return hashMap;
+}
+
+/**
+ * @brief  Frees the map and all its entries.
+ *
+ * @param  HASH_MAP the map to be freed.
+ */
+void deleteHashMap(HashMap *hashMap) {
+  free(hashMap->keys);
+  free(hashMap->used);
+  free(hashMap->values);
+  free(hashMap);
+}
+
+/**
+ * @brief  Returns the slot that holds KEY, or the free slot
+ *         where it would go if the map doesn't have it.
+ *
+ * @param  HASH_MAP pointer to the map.
+ * @param  KEY the key.
+ */
+int findHM(HashMap *hashMap, long key) {
+  int mask = hashMap->capacity - 1;
+  int i = slotHM(key, hashMap->capacity);
+  while (hashMap->used[i] && hashMap->keys[i] != key) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/**
+ * @brief  Returns a pointer to the value of KEY or NULL if the map
+ *         doesn't have it. The pointer is only valid until the map
+ *         changes.
+ *
+ * @param  HASH_MAP pointer to the map.
+ * @param  KEY the key.
+ */
+void* getHM(HashMap *hashMap, long key) {
+  int i = findHM(hashMap, key);
+  return hashMap->used[i] ? hashMap->values + i * hashMap->size : NULL;
+}
+
+/**
+ * @brief  Maps KEY to a copy of the value provided inside DATA,
+ *         replacing the value it had if it was already in the map.
+ *
+ * @param  HASH_MAP pointer to the map.
+ * @param  KEY the key.
+ * @param  DATA pointer to the value.
+ */
+void putHM(HashMap *hashMap, long key, void *data) {
+  // keep at least a quarter of the slots free so probes stay short
+  if (4 * (hashMap->length + 1) > 3 * hashMap->capacity) {
+    long *keys = hashMap->keys;
+    bool *used = hashMap->used;
+    char *values = hashMap->values;
+    int capacity = hashMap->capacity;
+    initSlotsHM(hashMap, 2 * capacity);
+    for (int i = 0; i < capacity; ++i) {
+      if (used[i]) {
+        int j = findHM(hashMap, keys[i]);
+        hashMap->keys[j] = keys[i];
+        hashMap->used[j] = true;
+        memcpy(hashMap->values + j * hashMap->size, values + i * hashMap->size,
+               hashMap->size);
+      }
+    }
+    free(keys);
+    free(used);
+    free(values);
+  }
+
+  int i = findHM(hashMap, key);
+  if (!hashMap->used[i]) {
+    hashMap->keys[i] = key;
+    hashMap->used[i] = true;
+    hashMap->length += 1;
+  }
+  memcpy(hashMap->values + i * hashMap->size, data, hashMap->size);
+}
+
+/**
+ * @brief  Removes KEY from the map and returns True
+ *         if the map had it.
+ *
+ * @param  HASH_MAP pointer to the map.
+ * @param  KEY the key.
+ */
+bool removeHM(HashMap *hashMap, long key) {
+  int mask = hashMap->capacity - 1;
+  int i = findHM(hashMap, key);
+  if (!hashMap->used[i]) {
+    return false;
+  }
+
+  // move back any entry after the hole that can't be found
+  // anymore with the hole in its way, so no tombstones are needed
+  int j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (!hashMap->used[j]) {
+      break;
+    }
+    int home = slotHM(hashMap->keys[j], hashMap->capacity);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      hashMap->keys[i] = hashMap->keys[j];
+      memcpy(hashMap->values + i * hashMap->size,
+             hashMap->values + j * hashMap->size, hashMap->size);
+      i = j;
+    }
+  }
+  hashMap->used[i] = false;
+  hashMap->length -= 1;
+  return true;
+}
+
+#endif
@@ -1,7 +1,16 @@
+#include "bitmap.h"
+#include "buddy.h"
 #include "circular_queue.h"
 #include "deque.h"
+#include "hash_map.h"
+#include "paging.h"
 #include "priority_queue.h"
+#include "rb_tree.h"
+#include "ring_buffer.h"
 #include <ctype.h>
+#include <getopt.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,6 +22,7 @@
 #include <sys/sem.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -20,18 +30,45 @@
 
 #define SHKEY 300
 #define BUFKEY 400
-#define BUFSEMKEY 500
-#define PROCSEMKEY 600
 
 // 1,000,000 = 1 sec
 #define CLOCK_TICK_DURATION 1000000
 #define DELAY_TIME 1000
 
 #define QUANTA 3
-#define BUFFER_SIZE 128
+// has to be a power of two
+#define BUFFER_SIZE 1024
 #define MAX_LINE_SIZE 256
 #define PROCESS_TABLE_SIZE 512
+#define WORKER_POOL_SIZE 16
+#define WORKER_CHUNK_SIZE 256
 #define MEMORY_SIZE 1024
+#define WAITING_BUCKETS 64
+// bytes compaction can move in one tick
+#define RELOCATION_RATE 256
+#define TLB_SIZE 16
+// memory accesses a running process makes every tick when
+// paging, one in PAGE_JUMP of them goes to a random page
+#define PAGE_ACCESSES 8
+#define PAGE_JUMP 16
+// bytes the backing store moves per tick and the ticks
+// every move to or from it waits before it starts
+#define SWAP_RATE 128
+#define SWAP_LATENCY 2
+// a multi-level feedback queue has at most one level for every bit
+// of a word, by default there are MLFQ_DEFAULT_LEVELS of them with a
+// quantum of QUANTA on the highest one that doubles on every level
+#define MLFQ_LEVELS 64
+#define MLFQ_DEFAULT_LEVELS 3
+#define MLFQ_BOOST 100
+// ticks the completely fair scheduler tries to run every process
+// in once, and the fewest ticks a process runs for once it starts
+#define CFS_LATENCY 24
+#define CFS_GRANULARITY 3
+// the virtual runtime a tick of a process of weight w adds is
+// CFS_SCALE / w, a tick of priority 0 is the unit of 1 << 10
+#define CFS_SCALE (1024l << 10)
+#define CFS_PRIORITIES 20
 
 typedef enum SCHEDULING_ALGORITHM {
   SCH_NONE,
@@ -39,7 +76,9 @@ typedef enum SCHEDULING_ALGORITHM {
   SJF,
   HPF,
   SRTN,
-  RR
+  RR,
+  MLFQ,
+  CFS
 } SCHEDULING_ALGORITHM;
 
 typedef enum MEMORY_ALLOCATION_ALGORTHIM{
@@ -47,9 +86,43 @@ typedef enum MEMORY_ALLOCATION_ALGORTHIM{
   FIRSTFIT,
   NEXTFIT,
   BESTFIT,
-  BUDDY
+  BUDDY,
+  FIRSTFIT_BM,
+  NEXTFIT_BM,
+  PAGING
 }MEMORY_ALLOCATION_ALGORTHIM;
 
+/**
+ * @brief  How the process to be swapped out is picked
+ *         when another one needs its memory.
+ */
+typedef enum SWAP_POLICY {
+  SWAP_NONE,
+  SWAP_LRU,
+  SWAP_LARGEST,
+  SWAP_PRIORITY,
+  SWAP_POLICY_COUNT
+} SWAP_POLICY;
+
+char *swapPolicies[SWAP_POLICY_COUNT] = {"none", "lru", "largest", "priority"};
+
+// the CPU share of a process of each priority like the nice levels
+// of Linux, every priority gets about 1.25 times less than the one
+// before it and the ones after the last get as little as it does
+int cfsWeights[CFS_PRIORITIES] = {1024, 820, 655, 526, 423, 335, 272,
+                                  215,  172, 137, 110, 87,  70,  56,
+                                  45,   36,  29,  23,  18,  15};
+
+/**
+ * @brief  Processes that have to finish their work for a tick
+ *         before a virtual clock is allowed to move on.
+ */
+typedef enum PARTICIPANT {
+  GENERATOR,
+  SCHEDULER,
+  PARTICIPANT_COUNT
+} PARTICIPANT;
+
 typedef enum PROCESS_STATE {
   WAITING,
   RUNNING
@@ -63,17 +136,52 @@ typedef struct Process {
   int arrival;
   int runtime;
   int priority;
-  int memsize;
+  long memsize;
 } Process;
 
 typedef struct ProcessInfo {
   int id;
   pid_t pid;
+  int worker;
 } ProcessInfo;
 
+/**
+ * @brief  Struct used to hand jobs to a pre-forked process.out worker
+ *         through shared memory. The scheduler bumps JOB after filling
+ *         in RUNTIME, sets STARTED to JOB the first time the job runs,
+ *         and the worker sets DONE to JOB once it finished it.
+ */
+typedef struct WorkerSlot {
+  int job;
+  int runtime;
+  int started;
+  int done;
+} WorkerSlot;
+
+/**
+ * @brief  Struct used by the scheduler to keep track of a worker.
+ */
+typedef struct Worker {
+  pid_t pid;
+  WorkerSlot *slot;
+} Worker;
+
 /**
  * @brief  Struct to represent the process control block
  *         which contains various info about a process.
+ *         WAIT only has the ticks it waited up to WAITING_SINCE,
+ *         the tick it last got ready or started waiting for memory,
+ *         the rest is added once it stops waiting.
+ *         SWAPPED is set while its memory is in the backing store
+ *         and SWAP_UNTIL is the tick its memory is back in by.
+ *         CONTINUED is set while its worker is let run, which is only
+ *         once its memory is back so it doesn't run out its runtime
+ *         while it waits for a swap in.
+ *         RESIDENT is its node in the processes holding memory.
+ *         LEVEL is the level of the multi-level feedback queue it's on.
+ *         VRUNTIME is the time it ran weighted by its priority, it's
+ *         relative to the least one of its core while it's handed to
+ *         another core.
  */
 typedef struct PCB {
   int id;
@@ -84,17 +192,121 @@ typedef struct PCB {
   int remain;
   int execution;
   int wait;
-  int memsize;
-  int memstart;
+  int waitingSince;
+  long memsize;
+  long memstart;
+  long *pageTable;
+  long cursor;
+  bool swapped;
+  int swapUntil;
+  bool continued;
+  Node *resident;
+  int level;
+  long vruntime;
   PROCESS_STATE state;
 } PCB;
 
+/**
+ * @brief  Struct used to represent one CPU of the simulated machine.
+ *         It has its own run queue, in the structure its scheduling
+ *         algorithm uses, and the process running on it.
+ *         ARRIVED has the processes handed to it that its algorithm
+ *         didn't take in yet, and UTILIZATION counts the ticks it ran
+ *         a process in. Its TLB only holds the translations of the
+ *         processes that ran on it.
+ *         With a multi-level feedback queue every level has its own
+ *         deque in LEVELS, bit i of NON_EMPTY is set while level i has
+ *         processes, and the running process isn't on any level.
+ *         BOOSTED is the last boost period it moved its processes
+ *         back to the highest level in.
+ *         With the completely fair scheduler the processes that aren't
+ *         running are in TIMELINE ordered by their virtual runtime,
+ *         MIN_VRUNTIME never goes back, WEIGHT is the total weight of
+ *         its processes and SLICE is the ticks the running one gets.
+ */
+typedef struct Core {
+  int id;
+  Deque *arrived;
+  Deque *deque;
+  PriorityQueue *priorityQueue;
+  CircularQueue *circularQueue;
+  ProcessInfo *runningProcess;
+  ProcessInfo current;
+  int quantum;
+  bool stalled;
+  int utilization;
+  TLB *tlb;
+  int tlbOwner;
+  Deque **levels;
+  unsigned long nonEmpty;
+  int boosted;
+  RBTree *timeline;
+  long minVruntime;
+  long weight;
+  int slice;
+} Core;
+
+/**
+ * @brief  Struct used to represent a process waiting for memory.
+ *         ORDER tells how many processes started waiting before it.
+ */
+typedef struct Waiter {
+  int id;
+  unsigned long order;
+} Waiter;
+
 typedef struct MemoryNode {
-  int start;
-  int size;
+  long start;
+  long size;
   int process;
 } MemoryNode;
 
+/**
+ * @brief  Struct used to represent the shared clock segment.
+ *         CLK must stay the first field since getClk() reads it.
+ *         DONE holds one past the last tick each participant
+ *         finished and NEXT the tick it needs to run next
+ *         (INT_MAX for none). A new segment is all zeros which
+ *         is exactly the state before anything has been released.
+ *         EVENTS is bumped whenever the clock moves or a participant
+ *         has something new for the others.
+ *         Every field is an int so it can be waited on as a futex.
+ */
+typedef struct SharedClock {
+  int clk;
+  int events;
+  int finished;
+  int done[PARTICIPANT_COUNT];
+  int next[PARTICIPANT_COUNT];
+} SharedClock;
+
+/**
+ * @brief  Struct used to hold the optional command line flags
+ *         shared by the process generator, clock and scheduler.
+ */
+typedef struct Options {
+  bool virtualTime;
+  bool tickless;
+  bool inProcess;
+  int poolSize;
+  int cores;
+  long memorySize;
+  long granularity;
+  bool compactOnDemand;
+  int compactPeriod;
+  long relocationRate;
+  int tlbSize;
+  bool flushTLB;
+  SWAP_POLICY swapPolicy;
+  long swapRate;
+  int swapLatency;
+  int levels;
+  int quanta[MLFQ_LEVELS];
+  int boostPeriod;
+  int targetLatency;
+  int minGranularity;
+} Options;
+
 // semun used to modify semaphore settings
 typedef union semun {
   int val;               /* Value for SETVAL */
@@ -109,22 +321,135 @@ typedef union semun {
 int *shmaddr; //
 //===============================
 
+SharedClock *sharedClock;
+Options options;
+
 int getClk() { return *shmaddr; }
 
+/*
+ * Blocks while the shared int at ADDR still holds VALUE, for at most
+ * USEC microseconds or forever if USEC is 0. It may return early, so
+ * callers always check their condition again in a loop.
+ */
+void futexWait(int *addr, int value, long usec) {
+  struct timespec timeout;
+  timeout.tv_sec = usec / 1000000;
+  timeout.tv_nsec = (usec % 1000000) * 1000;
+  syscall(SYS_futex, addr, FUTEX_WAIT, value, usec ? &timeout : NULL, NULL, 0);
+}
+
+/*
+ * Wakes up every process blocked in futexWait() on ADDR.
+ */
+void futexWake(int *addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/*
+ * Blocks until the clock moves past TICK and returns the new tick.
+ * The clock wakes every waiter as soon as it changes, so nobody has
+ * to poll getClk().
+ */
+int waitNextTick(int tick) {
+  int clk;
+  while ((clk = getClk()) == tick) {
+    futexWait(shmaddr, tick, 0);
+  }
+  return clk;
+}
+
+/*
+ * Bumps the event counter and wakes up everyone waiting for an event.
+ */
+void signalEvent() {
+  __atomic_add_fetch(&sharedClock->events, 1, __ATOMIC_SEQ_CST);
+  futexWake(&sharedClock->events);
+}
+
+/*
+ * Blocks until anything happened since the event counter read EVENTS,
+ * so a process can wait for several conditions with one primitive.
+ */
+void waitEvent(int events) {
+  while (__atomic_load_n(&sharedClock->events, __ATOMIC_SEQ_CST) == events) {
+    futexWait(&sharedClock->events, events, 0);
+  }
+}
+
+/*
+ * Sets the clock to TICK and wakes up everyone waiting for it.
+ */
+void setClk(int tick) {
+  *shmaddr = tick;
+  futexWake(shmaddr);
+  signalEvent();
+}
+
 /*
  * All processes call this function at the beginning to establish communication
  * between them and the clock module. Again, remember that the clock is only
  * emulation!
  */
 void initClk() {
-  int shmid = shmget(SHKEY, 4, 0444);
+  int shmid = shmget(SHKEY, sizeof(SharedClock), 0444);
   while ((int)shmid == -1) {
     // Make sure that the clock exists
     printf("Wait! The clock not initialized yet!\n");
     sleep(1);
-    shmid = shmget(SHKEY, 4, 0444);
+    shmid = shmget(SHKEY, sizeof(SharedClock), 0444);
   }
   shmaddr = (int *)shmat(shmid, (void *)0, 0);
+  sharedClock = (SharedClock *)shmaddr;
+}
+
+/*
+ * Called by a participant once it has done all its work for TICK.
+ * NEXT is the earliest tick it needs to see again, a virtual clock
+ * jumps straight to the smallest NEXT of all participants, while a
+ * real clock ignores it.
+ * Passing INT_MAX as TICK means the participant is done for good.
+ */
+void releaseTick(PARTICIPANT participant, int tick, int next) {
+  sharedClock->next[participant] = next;
+  __sync_synchronize();
+  sharedClock->done[participant] = (tick == INT_MAX) ? INT_MAX : tick + 1;
+  futexWake(&sharedClock->done[participant]);
+  signalEvent();
+}
+
+/*
+ * Returns True if PARTICIPANT has already released TICK.
+ */
+bool isReleased(PARTICIPANT participant, int tick) {
+  bool released = sharedClock->done[participant] > tick;
+  __sync_synchronize();
+  return released;
+}
+
+/*
+ * Blocks until PARTICIPANT has released TICK and returns True,
+ * or returns False if that didn't happen within USEC microseconds.
+ * Passing 0 as USEC waits for as long as it takes.
+ */
+bool waitRelease(PARTICIPANT participant, int tick, long usec) {
+  int done;
+  while ((done = sharedClock->done[participant]) <= tick) {
+    futexWait(&sharedClock->done[participant], done, usec);
+    if (usec && sharedClock->done[participant] <= tick) {
+      return false;
+    }
+  }
+  __sync_synchronize();
+  return true;
+}
+
+/*
+ * Blocks until the virtual clock has marked the simulation as finished.
+ */
+void waitFinished() {
+  while (!sharedClock->finished) {
+    futexWait(&sharedClock->finished, 0, 0);
+  }
 }
 
 /*
@@ -197,6 +522,8 @@ void printSchedulingAlgorithms() {
   printf("\t3. Preemptive Highest Priority First (HPF)\n");
   printf("\t4. Shortest Remaining Time Next (SRTN)\n");
   printf("\t5. Round Robin (RR)\n");
+  printf("\t6. Multi-Level Feedback Queue (MLFQ)\n");
+  printf("\t7. Completely Fair Scheduler (CFS)\n");
 }
 
 void printMemoryAllocationAlgorthims(){
@@ -205,12 +532,241 @@ void printMemoryAllocationAlgorthims(){
   printf("\t2. Next Fit\n");
   printf("\t3. Best Fit\n");
   printf("\t4. Buddy System Allocation\n");
+  printf("\t5. First Fit (bit map)\n");
+  printf("\t6. Next Fit (bit map)\n");
+  printf("\t7. Paging, pages are the allocation granularity\n");
+}
+
+void printOptions() {
+  printf("\nOptions available:\n");
+  printf("\t-v\tVirtual time, the clock jumps to the next event "
+         "instead of ticking every second\n");
+  printf("\t-n\tTickless, the scheduler sleeps through the ticks it has "
+         "nothing to decide in and catches up on the running process\n");
+  printf("\t-p N\tNumber of process workers to fork in advance "
+         "(default %d)\n", WORKER_POOL_SIZE);
+  printf("\t-i\tSimulate processes inside the scheduler "
+         "instead of running process.out\n");
+  printf("\t-u N\tNumber of CPUs, each with its own run queue, idle "
+         "ones steal processes from the busiest one (default 1)\n");
+  printf("\t-m N\tMemory size in bytes, K, M, G and T suffixes "
+         "are allowed (default %d)\n", MEMORY_SIZE);
+  printf("\t-g N\tAllocation granularity in bytes, sizes are "
+         "rounded up to it (default 1)\n");
+  printf("\t-c demand\tCompact the memory when a process doesn't fit "
+         "in any hole but fits in all of them together\n");
+  printf("\t-c N\tCompact the memory every N ticks if it has more "
+         "than one hole, both only work with the fit algorithms\n");
+  printf("\t-r N\tBytes compaction moves per tick, no memory can be "
+         "allocated until it's done (default %d)\n", RELOCATION_RATE);
+  printf("\t-t N\tNumber of TLB entries when paging (default %d)\n",
+         TLB_SIZE);
+  printf("\t-f\tFlush the TLB on context switches instead of "
+         "tagging its entries with their process\n");
+  printf("\t-s lru|largest|priority\tSwap processes that aren't running "
+         "out to a backing store when a process doesn't fit, the one that "
+         "ran the longest ago, the largest one or the lowest priority one "
+         "goes first\n");
+  printf("\t-b N\tBytes the backing store moves per tick (default %d)\n",
+         SWAP_RATE);
+  printf("\t-l N\tTicks every move to or from the backing store waits "
+         "before it starts (default %d)\n", SWAP_LATENCY);
+  printf("\t-q N,N,...\tQuantum of every MLFQ level from the highest "
+         "one down, a process that uses up its quantum moves a level down "
+         "(default %d,%d,%d)\n", QUANTA, QUANTA * 2, QUANTA * 4);
+  printf("\t-o N\tMove every MLFQ process back to the highest level "
+         "every N ticks, 0 never does (default %d)\n", MLFQ_BOOST);
+  printf("\t-d N\tTicks CFS tries to run every process in once, "
+         "shared by their priorities (default %d)\n", CFS_LATENCY);
+  printf("\t-k N\tFewest ticks a process runs for once CFS starts it "
+         "(default %d)\n", CFS_GRANULARITY);
 }
 
 void printHelp() {
   printf("Usage: process_generator.out [input file] [scheduling algorithm] "
-         "[memory allocation algorthim]\n");
+         "[memory allocation algorthim] [options]\n");
   printSchedulingAlgorithms();
   printMemoryAllocationAlgorthims();
-  printf("ex: process_generator.out input.txt 2 3\n");
+  printOptions();
+  printf("ex: process_generator.out input.txt 2 3 -v\n");
+}
+
+/*
+ * Parses a size like 64, 16K or 32G into bytes,
+ * returns -1 if it isn't a valid positive size.
+ */
+long parseSize(char *text) {
+  char *end;
+  long size = strtol(text, &end, 10);
+  // each suffix falls through to the ones below it, a size
+  // that wouldn't fit in a long after the shift is rejected
+  switch (toupper(*end)) {
+  case 'T':
+    if (size < 0 || size > LONG_MAX >> 10) {
+      return -1;
+    }
+    size <<= 10;
+    /* fall through */
+  case 'G':
+    if (size < 0 || size > LONG_MAX >> 10) {
+      return -1;
+    }
+    size <<= 10;
+    /* fall through */
+  case 'M':
+    if (size < 0 || size > LONG_MAX >> 10) {
+      return -1;
+    }
+    size <<= 10;
+    /* fall through */
+  case 'K':
+    if (size < 0 || size > LONG_MAX >> 10) {
+      return -1;
+    }
+    size <<= 10;
+    end += 1;
+  }
+  return size > 0 && !*end ? size : -1;
+}
+
+/*
+ * Parses comma separated quanta like 2,4,8 into the quanta of the
+ * MLFQ levels, returns the number of levels or -1 if it isn't
+ * a valid list of positive quanta.
+ */
+int parseQuanta(char *text) {
+  char *end;
+  for (int levels = 0; levels < MLFQ_LEVELS;) {
+    options.quanta[levels] = strtol(text, &end, 10);
+    if (options.quanta[levels++] <= 0) {
+      return -1;
+    }
+    if (*end != ',') {
+      return *end ? -1 : levels;
+    }
+    text = end + 1;
+  }
+  return -1;
+}
+
+/*
+ * Parses the optional flags into the global options and returns
+ * the index of the first positional argument. Options are moved
+ * to the front of ARGV so they can be forwarded as they are.
+ */
+int parseOptions(int argc, char *argv[]) {
+  int option;
+  memset(&options, 0, sizeof(Options));
+  options.poolSize = WORKER_POOL_SIZE;
+  options.cores = 1;
+  options.memorySize = MEMORY_SIZE;
+  options.granularity = 1;
+  options.relocationRate = RELOCATION_RATE;
+  options.tlbSize = TLB_SIZE;
+  options.swapRate = SWAP_RATE;
+  options.swapLatency = SWAP_LATENCY;
+  options.levels = MLFQ_DEFAULT_LEVELS;
+  for (int i = 0; i < MLFQ_DEFAULT_LEVELS; ++i) {
+    options.quanta[i] = QUANTA << i;
+  }
+  options.boostPeriod = MLFQ_BOOST;
+  options.targetLatency = CFS_LATENCY;
+  options.minGranularity = CFS_GRANULARITY;
+  while ((option = getopt(argc, argv, "vnip:u:m:g:c:r:t:fs:b:l:q:o:d:k:")) != -1) {
+    switch (option) {
+    case 'v':
+      options.virtualTime = true;
+      break;
+    case 'n':
+      options.tickless = true;
+      break;
+    case 'i':
+      options.inProcess = true;
+      break;
+    case 'p':
+      options.poolSize = atoi(optarg);
+      break;
+    case 'u':
+      options.cores = atoi(optarg);
+      break;
+    case 'm':
+      options.memorySize = parseSize(optarg);
+      break;
+    case 'g':
+      options.granularity = parseSize(optarg);
+      break;
+    case 'c':
+      if (!strcmp(optarg, "demand")) {
+        options.compactOnDemand = true;
+      } else if ((options.compactPeriod = atoi(optarg)) <= 0) {
+        printf("Invalid compaction period!\n");
+        printOptions();
+        exit(-1);
+      }
+      break;
+    case 'r':
+      options.relocationRate = parseSize(optarg);
+      break;
+    case 't':
+      options.tlbSize = atoi(optarg);
+      break;
+    case 'f':
+      options.flushTLB = true;
+      break;
+    case 's':
+      for (int i = SWAP_LRU; i < SWAP_POLICY_COUNT; ++i) {
+        if (!strcmp(optarg, swapPolicies[i])) {
+          options.swapPolicy = i;
+        }
+      }
+      if (!options.swapPolicy) {
+        printf("Invalid swap policy!\n");
+        printOptions();
+        exit(-1);
+      }
+      break;
+    case 'b':
+      options.swapRate = parseSize(optarg);
+      break;
+    case 'l':
+      options.swapLatency = atoi(optarg);
+      break;
+    case 'q':
+      options.levels = parseQuanta(optarg);
+      break;
+    case 'o':
+      options.boostPeriod = atoi(optarg);
+      break;
+    case 'd':
+      options.targetLatency = atoi(optarg);
+      break;
+    case 'k':
+      options.minGranularity = atoi(optarg);
+      break;
+    default:
+      printHelp();
+      exit(-1);
+    }
+  }
+  if (options.memorySize == -1 || options.granularity == -1 ||
+      options.granularity > options.memorySize ||
+      options.relocationRate == -1 || options.tlbSize <= 0 ||
+      options.swapRate == -1 || options.swapLatency < 0 ||
+      options.cores <= 0) {
+    printf("Invalid memory size, granularity, relocation rate, "
+           "TLB size, swap rate or number of CPUs!\n");
+    printOptions();
+    exit(-1);
+  }
+  if (options.levels == -1 || options.boostPeriod < 0) {
+    printf("Invalid MLFQ quanta or boost period!\n");
+    printOptions();
+    exit(-1);
+  }
+  if (options.targetLatency <= 0 || options.minGranularity <= 0) {
+    printf("Invalid CFS target latency or minimum granularity!\n");
+    printOptions();
+    exit(-1);
+  }
+  return optind;
 }
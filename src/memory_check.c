@@ -0,0 +1,432 @@
+#include <stdio.h>
+
+#include "bitmap.h"
+#include "buddy.h"
+#include "rb_tree.h"
+
+// checks the structures behind the memory allocators against simple
+// models: the hash map against an array, the red black tree and its
+// searches against a linear scan, the buddy system against a map of
+// the units it handed out and the bit map against an array of units
+
+#define ROUNDS 50
+#define STEPS 4000
+#define KEYS 4096
+#define NODES 512
+// enough words for the summary to be skipped a few words at a time
+#define UNITS (WORD_BITS * WORD_BITS * 10)
+
+bool failed = false;
+
+/*
+ * Reports a mismatch between a structure and its model.
+ */
+void fail(char *structure, int round, int step, char *what) {
+  if (!failed) {
+    printf("%s round %d step %d: %s\n", structure, round, step, what);
+  }
+  failed = true;
+}
+
+/*
+ * Puts and removes random keys, a lot of them with the same low bits
+ * so they collide, and checks every key is found with its value after
+ * every removal moved entries back into the hole it left.
+ */
+void checkHashMap(int round) {
+  HashMap *hashMap = newHashMap(sizeof(long));
+  static bool present[KEYS];
+  static long values[KEYS];
+  int length = 0;
+  memset(present, 0, sizeof(present));
+
+  for (int step = 0; step < STEPS && !failed; ++step) {
+    int i = rand() % KEYS;
+    // the key the map sees for index i
+    long key = round % 2 ? (long)i << 20 : i;
+    if (rand() % 3) {
+      long value = rand();
+      length += !present[i];
+      present[i] = true;
+      values[i] = value;
+      putHM(hashMap, key, &value);
+    } else if (removeHM(hashMap, key) != present[i]) {
+      fail("hash map", round, step, "remove");
+    } else {
+      length -= present[i];
+      present[i] = false;
+    }
+
+    if (hashMap->length != length) {
+      fail("hash map", round, step, "length");
+    }
+    // checking every key on every step is slow, every
+    // few steps still catches an entry that got lost
+    if (step % 16 && step != STEPS - 1) {
+      continue;
+    }
+    for (int j = 0; j < KEYS; ++j) {
+      long *value = (long *)getHM(hashMap, round % 2 ? (long)j << 20 : j);
+      if ((value != NULL) != present[j] ||
+          (value != NULL && *value != values[j])) {
+        fail("hash map", round, step, "lookup");
+      }
+    }
+  }
+  deleteHashMap(hashMap);
+}
+
+/*
+ * Checks the subtree of NODE and returns its black height, or -1 if
+ * it's broken. Children have to point back at their parent, keys have
+ * to be in order, no red node can have a red child, every path needs
+ * the same number of black nodes and MAX has to be the biggest value.
+ */
+int checkSubtreeRB(RBNode *node, RBNode *parent) {
+  if (node == NULL) {
+    return 0;
+  }
+  if (node->parent != parent) {
+    return -1;
+  }
+  if (node->left != NULL &&
+      compareRB(node->left, node->key, node->tie) >= 0) {
+    return -1;
+  }
+  if (node->right != NULL &&
+      compareRB(node->right, node->key, node->tie) <= 0) {
+    return -1;
+  }
+  if (node->red && (isRedRB(node->left) || isRedRB(node->right))) {
+    return -1;
+  }
+  long max = node->value;
+  if (node->left != NULL && node->left->max > max) {
+    max = node->left->max;
+  }
+  if (node->right != NULL && node->right->max > max) {
+    max = node->right->max;
+  }
+  if (node->max != max) {
+    return -1;
+  }
+  int left = checkSubtreeRB(node->left, node);
+  int right = checkSubtreeRB(node->right, node);
+  if (left == -1 || left != right) {
+    return -1;
+  }
+  return left + !node->red;
+}
+
+/*
+ * Inserts, removes and changes the value of random nodes, then checks
+ * the tree is still a red black tree with the right maxima and that
+ * ceilingRB, fitRB, firstRB and lastRB find what a linear scan finds.
+ * Keys repeat often so the tie breaker matters.
+ */
+void checkRBTree(int round) {
+  RBTree *tree = newRBTree(sizeof(int));
+  static bool present[NODES];
+  static long keys[NODES];
+  static long values[NODES];
+  int length = 0;
+  memset(present, 0, sizeof(present));
+
+  for (int step = 0; step < STEPS && !failed; ++step) {
+    // the tie is the index so every node is unique
+    int i = rand() % NODES;
+    int operation = rand() % 3;
+    if (!present[i]) {
+      present[i] = true;
+      keys[i] = rand() % 64;
+      values[i] = rand() % 1000;
+      length += 1;
+      insertRB(tree, keys[i], i, values[i], &i);
+    } else if (operation == 0) {
+      removeRB(tree, findRB(tree, keys[i], i));
+      present[i] = false;
+      length -= 1;
+    } else {
+      RBNode *node = findRB(tree, keys[i], i);
+      if (node == NULL || *(int *)node->data != i) {
+        fail("red black tree", round, step, "find");
+        break;
+      }
+      values[i] = rand() % 1000;
+      updateValueRB(node, values[i]);
+    }
+
+    if (tree->length != length) {
+      fail("red black tree", round, step, "length");
+    }
+    if (isRedRB(tree->root) || checkSubtreeRB(tree->root, NULL) == -1) {
+      fail("red black tree", round, step, "invariant");
+    }
+
+    // the first node by key and tie that matches, -1 for none
+    long key = rand() % 70;
+    long value = rand() % 1100;
+    int ceiling = -1;
+    int fit = -1;
+    int first = -1;
+    int last = -1;
+    for (int j = 0; j < NODES; ++j) {
+      if (!present[j]) {
+        continue;
+      }
+      bool after = keys[j] >= key;
+      bool beforeCeiling = ceiling == -1 || keys[j] < keys[ceiling];
+      bool beforeFit = fit == -1 || keys[j] < keys[fit];
+      if (after && beforeCeiling) {
+        ceiling = j;
+      }
+      if (after && values[j] >= value && beforeFit) {
+        fit = j;
+      }
+      if (first == -1 || keys[j] < keys[first]) {
+        first = j;
+      }
+      if (last == -1 || keys[j] >= keys[last]) {
+        last = j;
+      }
+    }
+    RBNode *found = ceilingRB(tree, key, -1);
+    if ((found == NULL ? -1 : *(int *)found->data) != ceiling) {
+      fail("red black tree", round, step, "ceilingRB");
+    }
+    found = fitRB(tree, key, value);
+    if ((found == NULL ? -1 : *(int *)found->data) != fit) {
+      fail("red black tree", round, step, "fitRB");
+    }
+    found = firstRB(tree);
+    if ((found == NULL ? -1 : *(int *)found->data) != first) {
+      fail("red black tree", round, step, "firstRB");
+    }
+    found = lastRB(tree);
+    if ((found == NULL ? -1 : *(int *)found->data) != last) {
+      fail("red black tree", round, step, "lastRB");
+    }
+  }
+  deleteRBTree(tree);
+}
+
+/*
+ * Allocates and frees random sizes, checking every block is aligned to
+ * its size and doesn't overlap another one, that no two free buddies
+ * are left unmerged and that the free blocks and the allocated ones add
+ * up to the whole memory. Once everything is freed the memory has to be
+ * back to the blocks it started with.
+ */
+void checkBuddy(int round) {
+  // a size that isn't a power of two starts as several blocks
+  long size = round % 2 ? 1000 : 1024;
+  Buddy *buddy = newBuddy(size);
+  static int owners[1024];
+  static long starts[NODES];
+  static long sizes[NODES];
+  int count = 0;
+  memset(owners, -1, sizeof(owners));
+
+  for (int step = 0; step < STEPS && !failed; ++step) {
+    if (count && rand() % 2) {
+      int i = rand() % count;
+      long units = ceilPowerOfTwo(sizes[i]);
+      for (long unit = starts[i]; unit < starts[i] + units; ++unit) {
+        owners[unit] = -1;
+      }
+      freeBuddy(buddy, starts[i], sizes[i]);
+      count -= 1;
+      starts[i] = starts[count];
+      sizes[i] = sizes[count];
+    } else if (count < NODES) {
+      long units = 1 + rand() % (rand() % 4 ? 16 : 300);
+      // it only fails when there's no free block big enough
+      int order = orderBuddy(units);
+      bool fits = order < buddy->orders && buddy->nonEmpty >> order;
+      long start = allocateBuddy(buddy, units);
+      if ((start == -1) == fits) {
+        fail("buddy", round, step, "allocate");
+        break;
+      }
+      if (start == -1) {
+        continue;
+      }
+      long block = ceilPowerOfTwo(units);
+      if (start % block || start + block > size) {
+        fail("buddy", round, step, "alignment");
+        break;
+      }
+      for (long unit = start; unit < start + block; ++unit) {
+        if (owners[unit] != -1) {
+          fail("buddy", round, step, "overlap");
+        }
+        owners[unit] = count;
+      }
+      starts[count] = start;
+      sizes[count] = units;
+      count += 1;
+    }
+
+    long free = 0;
+    for (int order = 0; order < buddy->orders; ++order) {
+      long start = buddy->heads[order];
+      if ((start != -1) != ((buddy->nonEmpty >> order) & 1)) {
+        fail("buddy", round, step, "non empty bits");
+      }
+      while (start != -1) {
+        BuddyBlock *block = (BuddyBlock *)getHM(buddy->blocks, start);
+        BuddyBlock *other =
+            (BuddyBlock *)getHM(buddy->blocks, start ^ (1l << order));
+        if (block == NULL || block->order != order ||
+            start % (1l << order)) {
+          fail("buddy", round, step, "free block");
+          break;
+        }
+        if (other != NULL && other->order == order &&
+            order + 1 < buddy->orders) {
+          fail("buddy", round, step, "unmerged buddies");
+        }
+        for (long unit = start; unit < start + (1l << order); ++unit) {
+          if (owners[unit] != -1) {
+            fail("buddy", round, step, "free block is allocated");
+          }
+        }
+        free += 1l << order;
+        start = block->next;
+      }
+    }
+    long used = 0;
+    for (int i = 0; i < count; ++i) {
+      used += ceilPowerOfTwo(sizes[i]);
+    }
+    if (free + used != size) {
+      fail("buddy", round, step, "free and used units");
+    }
+  }
+
+  while (count) {
+    count -= 1;
+    freeBuddy(buddy, starts[count], sizes[count]);
+  }
+  for (int order = 0; order < buddy->orders; ++order) {
+    bool initial = (size >> order) & 1;
+    if ((buddy->heads[order] != -1) != initial) {
+      fail("buddy", round, STEPS, "not merged back");
+    }
+  }
+  deleteBuddy(buddy);
+}
+
+/*
+ * Returns the start of the first run of SIZE free units from FROM on
+ * in USED, or -1 if there's none.
+ */
+long fitModel(bool *used, long units, long from, long size) {
+  long run = 0;
+  for (long unit = from; unit < units; ++unit) {
+    run = used[unit] ? 0 : run + 1;
+    if (run == size) {
+      return unit - size + 1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Allocates and frees runs of random sizes with fitBM and markBM, some
+ * of them long enough to fill whole summary words, and checks that
+ * fitBM finds the run a linear scan finds from a random unit on, that
+ * runsBM and largestRunBM see the same runs and that the summary bits
+ * match the words.
+ */
+void checkBitMap(int round) {
+  // a size that isn't a multiple of the word size ends in a padded word
+  long units = 1 + rand() % UNITS;
+  BitMap *bitMap = newBitMap(units);
+  static bool used[UNITS];
+  static long starts[NODES];
+  static long sizes[NODES];
+  int count = 0;
+  memset(used, 0, sizeof(used));
+
+  for (int step = 0; step < STEPS / 4 && !failed; ++step) {
+    long from = rand() % units;
+    long size = 1 + rand() % (rand() % 8 ? 64 : units / 4 + 1);
+    long start = fitBM(bitMap, from, size);
+    if (start != fitModel(used, units, from, size)) {
+      fail("bit map", round, step, "fitBM");
+      break;
+    }
+
+    if (count && rand() % 2) {
+      int i = rand() % count;
+      markBM(bitMap, starts[i], sizes[i], false);
+      memset(used + starts[i], false, sizes[i]);
+      count -= 1;
+      starts[i] = starts[count];
+      sizes[i] = sizes[count];
+    } else if (count < NODES && start != -1) {
+      markBM(bitMap, start, size, true);
+      memset(used + start, true, size);
+      starts[count] = start;
+      sizes[count] = size;
+      count += 1;
+    }
+
+    // a full check reads every unit so it's only done every few steps
+    if (step % 16 && step != STEPS / 4 - 1) {
+      continue;
+    }
+    for (long i = 0; i < bitMap->wordCount; ++i) {
+      unsigned long word = 0;
+      for (long bit = 0; bit < WORD_BITS; ++bit) {
+        long unit = i * WORD_BITS + bit;
+        if (unit >= units || used[unit]) {
+          word |= 1ul << bit;
+        }
+      }
+      bool full = (bitMap->full[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+      bool any = (bitMap->any[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+      if (bitMap->words[i] != word || full != (word == FULL_WORD) ||
+          any != (word != 0)) {
+        fail("bit map", round, step, "words");
+        break;
+      }
+    }
+    long runs = 0;
+    long largest = 0;
+    long run = 0;
+    for (long unit = 0; unit <= units; ++unit) {
+      if (unit < units && !used[unit]) {
+        run += 1;
+        continue;
+      }
+      runs += run > 0;
+      largest = run > largest ? run : largest;
+      run = 0;
+    }
+    long largestBM;
+    if (runsBM(bitMap, &largestBM) != runs || largestBM != largest) {
+      fail("bit map", round, step, "runsBM");
+    }
+    if (largestRunBM(bitMap) != largest) {
+      fail("bit map", round, step, "largestRunBM");
+    }
+  }
+  deleteBitMap(bitMap);
+}
+
+int main(int argc, char *argv[]) {
+  srand(argc > 1 ? atoi(argv[1]) : 1313);
+
+  for (int round = 0; round < ROUNDS && !failed; ++round) {
+    checkHashMap(round);
+    checkRBTree(round);
+    checkBuddy(round);
+    checkBitMap(round);
+  }
+
+  printf("hash map, red black tree, buddy and bit map %s\n",
+         failed ? "DIFFERENT" : "same");
+  return failed ? 1 : 0;
+}
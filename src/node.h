@@ -1,8 +1,12 @@
 #ifndef __NODE_H
 #define __NODE_H
 
+#include "pool.h"
+#include <string.h>
+
 /**
  * @brief  Struct used to represent one element in a collection.
+ *         The data is stored right after the node in the same block.
  */
 typedef struct Node {
   void *data;
@@ -10,4 +14,30 @@ typedef struct Node {
   struct Node *prev;
 } Node;
 
+/**
+ * @brief  Initializes POOL to hand out nodes
+ *         with node data of size SIZE.
+ *
+ * @param  POOL pointer to the pool.
+ * @param  SIZE size of the node data.
+ */
+void initNodePool(Pool *pool, size_t size) {
+  initPool(pool, alignPool(sizeof(Node)) + size);
+}
+
+/**
+ * @brief  Returns a new node from POOL containing
+ *         a copy of the SIZE bytes at DATA.
+ *
+ * @param  POOL pointer to the pool.
+ * @param  DATA pointer to the data to be copied.
+ * @param  SIZE size of the node data.
+ */
+Node* allocateNode(Pool *pool, void *data, size_t size) {
+  Node *node = (Node *)allocatePool(pool);
+  node->data = (char *)node + alignPool(sizeof(Node));
+  memcpy(node->data, data, size);
+  return node;
+}
+
 #endif
@@ -0,0 +1,198 @@
+#ifndef __PAGING_H
+#define __PAGING_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * @brief  Struct used to hand out the SIZE frames of a paged memory.
+ *         Frames from NEXT on were never used and are handed out in
+ *         order, frames that were freed are kept in the FREE stack
+ *         and handed out first, so it only takes memory for the frames
+ *         that were freed and not for every frame.
+ *         STEPS counts the frames it handed out.
+ */
+typedef struct Frames {
+  long size;
+  long next;
+  long *free;
+  long freeLength;
+  long freeCapacity;
+  long steps;
+} Frames;
+
+/**
+ * @brief  Struct used to represent a fully associative TLB of SIZE
+ *         entries, entry i maps page PAGES[i] of process OWNERS[i] and
+ *         was last used at USED[i], the least recently used entry is
+ *         the one replaced on a miss. Entries with owner 0 are empty.
+ */
+typedef struct TLB {
+  long *pages;
+  int *owners;
+  unsigned long *used;
+  int size;
+  unsigned long clock;
+  long hits;
+  long misses;
+  long flushes;
+} TLB;
+
+/**
+ * @brief  Creates and returns a new frame allocator
+ *         with SIZE free frames.
+ *
+ * @param  SIZE number of frames.
+ */
+Frames* newFrames(long size) {
+  Frames *frames = (Frames *)malloc(sizeof(Frames));
+  frames->size = size;
+  frames->next = 0;
+  frames->free = NULL;
+  frames->freeLength = 0;
+  frames->freeCapacity = 0;
+  frames->steps = 0;
+  return frames;
+}
+
+/**
+ * @brief  Frees the frame allocator.
+ *
+ * @param  FRAMES the frame allocator to be freed.
+ */
+void deleteFrames(Frames *frames) {
+  free(frames->free);
+  free(frames);
+}
+
+/**
+ * @brief  Returns the number of free frames.
+ *
+ * @param  FRAMES pointer to the frame allocator.
+ */
+long freeFrames(Frames *frames) {
+  return frames->size - frames->next + frames->freeLength;
+}
+
+/**
+ * @brief  Takes COUNT free frames and writes them to TABLE, returns
+ *         False without taking any if there aren't enough of them.
+ *
+ * @param  FRAMES pointer to the frame allocator.
+ * @param  TABLE where the frames go, at least COUNT long.
+ * @param  COUNT number of frames.
+ */
+bool takeFrames(Frames *frames, long *table, long count) {
+  if (freeFrames(frames) < count) {
+    return false;
+  }
+  frames->steps += count;
+  for (long i = 0; i < count; ++i) {
+    if (frames->freeLength) {
+      table[i] = frames->free[--frames->freeLength];
+    } else {
+      table[i] = frames->next++;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Gives the COUNT frames in TABLE back to the frame allocator.
+ *
+ * @param  FRAMES pointer to the frame allocator.
+ * @param  TABLE the frames.
+ * @param  COUNT number of frames.
+ */
+void giveFrames(Frames *frames, long *table, long count) {
+  if (frames->freeLength + count > frames->freeCapacity) {
+    while (frames->freeLength + count > frames->freeCapacity) {
+      frames->freeCapacity = frames->freeCapacity ? frames->freeCapacity * 2
+                                                  : count;
+    }
+    frames->free = (long *)realloc(frames->free,
+                                   frames->freeCapacity * sizeof(long));
+  }
+  // pushed backwards so the first frame is handed out first again
+  for (long i = count - 1; i >= 0; --i) {
+    frames->free[frames->freeLength++] = table[i];
+  }
+}
+
+/**
+ * @brief  Creates and returns a new empty TLB of SIZE entries.
+ *
+ * @param  SIZE number of entries.
+ */
+TLB* newTLB(int size) {
+  TLB *tlb = (TLB *)malloc(sizeof(TLB));
+  tlb->pages = (long *)malloc(size * sizeof(long));
+  tlb->owners = (int *)calloc(size, sizeof(int));
+  tlb->used = (unsigned long *)calloc(size, sizeof(unsigned long));
+  tlb->size = size;
+  tlb->clock = 0;
+  tlb->hits = 0;
+  tlb->misses = 0;
+  tlb->flushes = 0;
+  return tlb;
+}
+
+/**
+ * @brief  Frees the TLB.
+ *
+ * @param  TLB the TLB to be freed.
+ */
+void deleteTLB(TLB *tlb) {
+  free(tlb->pages);
+  free(tlb->owners);
+  free(tlb->used);
+  free(tlb);
+}
+
+/**
+ * @brief  Looks PAGE of process OWNER up and returns True on a hit,
+ *         on a miss the page takes the least recently used entry.
+ *
+ * @param  TLB pointer to the TLB.
+ * @param  OWNER id of the process, not 0.
+ * @param  PAGE the page.
+ */
+bool lookupTLB(TLB *tlb, int owner, long page) {
+  int victim = 0;
+  tlb->clock += 1;
+  for (int i = 0; i < tlb->size; ++i) {
+    if (tlb->owners[i] == owner && tlb->pages[i] == page) {
+      tlb->used[i] = tlb->clock;
+      tlb->hits += 1;
+      return true;
+    }
+    if (tlb->used[i] < tlb->used[victim]) {
+      victim = i;
+    }
+  }
+  tlb->owners[victim] = owner;
+  tlb->pages[victim] = page;
+  tlb->used[victim] = tlb->clock;
+  tlb->misses += 1;
+  return false;
+}
+
+/**
+ * @brief  Empties the TLB, or only the entries of OWNER if it isn't 0.
+ *
+ * @param  TLB pointer to the TLB.
+ * @param  OWNER id of the process or 0 for all of them.
+ */
+void flushTLB(TLB *tlb, int owner) {
+  for (int i = 0; i < tlb->size; ++i) {
+    if (!owner || tlb->owners[i] == owner) {
+      tlb->owners[i] = 0;
+      tlb->used[i] = 0;
+    }
+  }
+  if (!owner) {
+    tlb->flushes += 1;
+  }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define POOL_CHUNK_SIZE 16
+#define POOL_MAX_CHUNK_SIZE 4096
+
+/**
+ * @brief  Struct used to hand out blocks of one size without going
+ *         to malloc for every block. Blocks are carved out of chunks
+ *         that grow as the pool does and are only freed together,
+ *         so a block never moves while it's in use. Released blocks
+ *         are kept in a free list and handed out again first, so once
+ *         a pool is big enough it doesn't call malloc at all.
+ */
+typedef struct Pool {
+  size_t stride;
+  void *free;
+  void *chunks;
+  char *next;
+  int remaining;
+  int chunkLength;
+} Pool;
+
+/**
+ * @brief  Returns SIZE rounded up so that anything can be stored after it.
+ *
+ * @param  SIZE number of bytes.
+ */
+size_t alignPool(size_t size) {
+  size_t alignment = _Alignof(max_align_t);
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief  Initializes POOL to hand out blocks of size SIZE.
+ *
+ * @param  POOL pointer to the pool.
+ * @param  SIZE size of each block.
+ */
+void initPool(Pool *pool, size_t size) {
+  pool->stride = alignPool(size < sizeof(void *) ? sizeof(void *) : size);
+  pool->free = NULL;
+  pool->chunks = NULL;
+  pool->next = NULL;
+  pool->remaining = 0;
+  pool->chunkLength = POOL_CHUNK_SIZE;
+}
+
+/**
+ * @brief  Returns a block from the pool, reusing a released block
+ *         if there's one and carving a new one otherwise.
+ *
+ * @param  POOL pointer to the pool.
+ */
+void* allocatePool(Pool *pool) {
+  if (pool->free != NULL) {
+    void *block = pool->free;
+    pool->free = *(void **)block;
+    return block;
+  }
+
+  if (!pool->remaining) {
+    // every chunk starts with a pointer to the chunk before it
+    size_t header = alignPool(sizeof(void *));
+    char *chunk = (char *)malloc(header + pool->chunkLength * pool->stride);
+    *(void **)chunk = pool->chunks;
+    pool->chunks = chunk;
+    pool->next = chunk + header;
+    pool->remaining = pool->chunkLength;
+    if (pool->chunkLength < POOL_MAX_CHUNK_SIZE) {
+      pool->chunkLength *= 2;
+    }
+  }
+
+  void *block = pool->next;
+  pool->next += pool->stride;
+  pool->remaining -= 1;
+  return block;
+}
+
+/**
+ * @brief  Gives BLOCK back to the pool so it can be handed out again.
+ *
+ * @param  POOL pointer to the pool.
+ * @param  BLOCK a block returned by allocatePool().
+ */
+void releasePool(Pool *pool, void *block) {
+  *(void **)block = pool->free;
+  pool->free = block;
+}
+
+/**
+ * @brief  Frees every chunk of the pool, all of its blocks
+ *         are invalid afterwards.
+ *
+ * @param  POOL pointer to the pool.
+ */
+void clearPool(Pool *pool) {
+  while (pool->chunks != NULL) {
+    void *chunk = pool->chunks;
+    pool->chunks = *(void **)chunk;
+    free(chunk);
+  }
+  initPool(pool, pool->stride);
+}
+
+#endif
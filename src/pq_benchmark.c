@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "priority_queue.h"
+
+// the linked list priority queue that priority_queue.h used to be,
+// kept here so the heap can be timed and checked against it
+
+typedef struct ListNode {
+  void *data;
+  int priority;
+  struct ListNode *next;
+} ListNode;
+
+typedef struct ListQueue {
+  ListNode *head;
+  size_t size;
+  int length;
+} ListQueue;
+
+ListQueue* newListQueue(size_t size) {
+  ListQueue *listQueue = (ListQueue *)malloc(sizeof(ListQueue));
+  listQueue->head = NULL;
+  listQueue->size = size;
+  listQueue->length = 0;
+  return listQueue;
+}
+
+void enqueueLQ(ListQueue *listQueue, void *data, int priority, bool keepHead) {
+  ListNode *start = listQueue->head;
+  ListNode *node = (ListNode *)malloc(sizeof(ListNode));
+  node->data = malloc(listQueue->size);
+  node->priority = priority;
+
+  memcpy(node->data, data, listQueue->size);
+  listQueue->length += 1;
+
+  if (listQueue->head == NULL) {
+    node->next = NULL;
+    listQueue->head = node;
+    return;
+  }
+
+  if (start->priority < priority && !keepHead) {
+    node->next = start;
+    listQueue->head = node;
+    return;
+  }
+
+  while (start->next != NULL && start->next->priority >= priority) {
+    start = start->next;
+  }
+
+  node->next = start->next;
+  start->next = node;
+}
+
+bool dequeueLQ(ListQueue *listQueue, void **data) {
+  ListNode *node = listQueue->head;
+
+  if (node == NULL) {
+    return false;
+  }
+
+  if (*data == NULL) {
+    *data = malloc(listQueue->size);
+  }
+
+  memcpy(*data, node->data, listQueue->size);
+
+  listQueue->head = node->next;
+  listQueue->length -= 1;
+
+  free(node->data);
+  free(node);
+  return true;
+}
+
+/*
+ * A workload is a list of operations replayed on both queues,
+ * a non negative operation inserts its value with a random
+ * priority and a negative one removes the head.
+ */
+typedef struct Workload {
+  int *values;
+  int *priorities;
+  int length;
+} Workload;
+
+/*
+ * Builds a workload that inserts COUNT values with priorities in
+ * [0, RANGE) and removes one head after every BATCH inserts, then
+ * removes everything that's left, like a scheduler under a burst.
+ */
+Workload newWorkload(int count, int range, int batch) {
+  Workload workload;
+  workload.values = (int *)malloc(2 * count * sizeof(int));
+  workload.priorities = (int *)malloc(2 * count * sizeof(int));
+  workload.length = 0;
+
+  int inserted = 0;
+  for (int i = 0; i < count; ++i) {
+    workload.values[workload.length] = i;
+    workload.priorities[workload.length] = -(rand() % range);
+    workload.length += 1;
+    inserted += 1;
+    if (inserted % batch == 0) {
+      workload.values[workload.length++] = -1;
+    }
+  }
+
+  int removed = inserted / batch;
+  for (int i = removed; i < count; ++i) {
+    workload.values[workload.length++] = -1;
+  }
+
+  return workload;
+}
+
+double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/*
+ * Replays the workload on a heap and writes the removed values to ORDER,
+ * returns how long it took in seconds.
+ */
+double runHeap(Workload *workload, bool keepHead, int *order) {
+  PriorityQueue *priorityQueue = newPriorityQueue(sizeof(int));
+  int value, removed = 0;
+  int *data = &value;
+
+  double start = now();
+  for (int i = 0; i < workload->length; ++i) {
+    if (workload->values[i] >= 0) {
+      enqueuePQ(priorityQueue, workload->values + i, workload->priorities[i],
+                keepHead);
+    } else if (dequeuePQ(priorityQueue, (void **)&data)) {
+      order[removed++] = value;
+    }
+  }
+  double end = now();
+
+  deletePriorityQueue(priorityQueue);
+  return end - start;
+}
+
+/*
+ * Replays the workload on a linked list and writes the removed values
+ * to ORDER, returns how long it took in seconds.
+ */
+double runList(Workload *workload, bool keepHead, int *order) {
+  ListQueue *listQueue = newListQueue(sizeof(int));
+  int value, removed = 0;
+  int *data = &value;
+
+  double start = now();
+  for (int i = 0; i < workload->length; ++i) {
+    if (workload->values[i] >= 0) {
+      enqueueLQ(listQueue, workload->values + i, workload->priorities[i],
+                keepHead);
+    } else if (dequeueLQ(listQueue, (void **)&data)) {
+      order[removed++] = value;
+    }
+  }
+  double end = now();
+
+  free(listQueue);
+  return end - start;
+}
+
+int main(int argc, char *argv[]) {
+  int counts[] = {1000, 10000, 50000};
+  int ranges[] = {10, 1000};
+  bool matched = true;
+
+  srand(argc > 1 ? atoi(argv[1]) : 303);
+
+  printf("count\trange\tkeep\tlist(ms)\theap(ms)\tspeedup\torder\n");
+  for (size_t c = 0; c < sizeof(counts) / sizeof(int); ++c) {
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(int); ++r) {
+      for (int keepHead = 0; keepHead <= 1; ++keepHead) {
+        Workload workload = newWorkload(counts[c], ranges[r], 4);
+        int *heapOrder = (int *)malloc(counts[c] * sizeof(int));
+        int *listOrder = (int *)malloc(counts[c] * sizeof(int));
+
+        double list = runList(&workload, keepHead, listOrder);
+        double heap = runHeap(&workload, keepHead, heapOrder);
+        bool same = !memcmp(heapOrder, listOrder, counts[c] * sizeof(int));
+        matched = matched && same;
+
+        printf("%d\t%d\t%d\t%.2f\t\t%.2f\t\t%.1fx\t%s\n", counts[c],
+               ranges[r], keepHead, list * 1000, heap * 1000, list / heap,
+               same ? "same" : "DIFFERENT");
+
+        free(heapOrder);
+        free(listOrder);
+        free(workload.values);
+        free(workload.priorities);
+      }
+    }
+  }
+
+  return matched ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+
+#include "priority_queue.h"
+
+// checks the keyed operations of the heap against a linear scan model,
+// every node has a key and the model keeps the nodes by their keys
+
+#define KEYS 512
+#define ROUNDS 200
+#define STEPS 5000
+
+typedef struct Model {
+  bool alive[KEYS];
+  int priority[KEYS];
+  unsigned long order[KEYS];
+  int value[KEYS];
+  int length;
+  unsigned long count;
+  int head;
+} Model;
+
+bool failed = false;
+
+/*
+ * Reports a mismatch between the heap and the model.
+ */
+void fail(int round, int step, char *what) {
+  if (!failed) {
+    printf("round %d step %d: %s\n", round, step, what);
+  }
+  failed = true;
+}
+
+/*
+ * Returns True if key A comes before key B in the model.
+ */
+bool beforeModel(Model *model, int a, int b) {
+  if (model->priority[a] != model->priority[b]) {
+    return model->priority[a] > model->priority[b];
+  }
+  return model->order[a] < model->order[b];
+}
+
+/*
+ * Returns the key that comes first among the live keys
+ * other than SKIP, or -1 if there's none.
+ */
+int bestModel(Model *model, int skip) {
+  int best = -1;
+  for (int key = 0; key < KEYS; ++key) {
+    if (model->alive[key] && key != skip &&
+        (best == -1 || beforeModel(model, key, best))) {
+      best = key;
+    }
+  }
+  return best;
+}
+
+/*
+ * Returns a random live key of the model or -1 if it's empty.
+ */
+int randomKey(Model *model) {
+  if (!model->length) {
+    return -1;
+  }
+  int key = rand() % KEYS;
+  while (!model->alive[key]) {
+    key = (key + 1) % KEYS;
+  }
+  return key;
+}
+
+/*
+ * Takes KEY out of the model, a removed head is
+ * replaced by the key that comes first after it.
+ */
+void removeModel(Model *model, int key) {
+  model->alive[key] = false;
+  model->length -= 1;
+  if (model->head == key) {
+    model->head = bestModel(model, -1);
+  }
+}
+
+/*
+ * Gives KEY a new priority in the model, it only takes the place of the
+ * head if it comes before it, or becomes the head again if it was the
+ * head and now comes before the others, unless KEEP_HEAD is set.
+ */
+void placeModel(Model *model, int key, bool keepHead) {
+  if (model->head == -1) {
+    model->head = key;
+  } else if (keepHead) {
+    return;
+  } else if (model->head == key) {
+    model->head = bestModel(model, -1);
+  } else if (beforeModel(model, key, model->head)) {
+    model->head = key;
+  }
+}
+
+/*
+ * Checks that the heap has the nodes of the model with their data,
+ * that every key is found where it is, that the head is the one of
+ * the model and that no node but the head comes before its parent.
+ */
+void checkHeap(PriorityQueue *priorityQueue, Model *model, int round,
+               int step) {
+  if (priorityQueue->length != model->length) {
+    fail(round, step, "length");
+    return;
+  }
+  if (model->length && priorityQueue->nodes[0].key != model->head) {
+    fail(round, step, "head");
+  }
+  for (int i = 0; i < priorityQueue->length; ++i) {
+    PriorityNode *node = priorityQueue->nodes + i;
+    if (!model->alive[node->key] ||
+        node->priority != model->priority[node->key] ||
+        *(int *)node->data != model->value[node->key]) {
+      fail(round, step, "node");
+    }
+    if (findPQ(priorityQueue, node->key) != i) {
+      fail(round, step, "position");
+    }
+    int parent = (i - 1) / 2;
+    if (parent > 0 && beforePQ(node, priorityQueue->nodes + parent)) {
+      fail(round, step, "heap order");
+    }
+  }
+  for (int key = 0; key < KEYS; ++key) {
+    if (!model->alive[key] && findPQ(priorityQueue, key) != -1) {
+      fail(round, step, "stale position");
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  srand(argc > 1 ? atoi(argv[1]) : 808);
+
+  for (int round = 0; round < ROUNDS && !failed; ++round) {
+    PriorityQueue *priorityQueue = newPriorityQueue(sizeof(int));
+    Model model;
+    memset(&model, 0, sizeof(Model));
+    model.head = -1;
+    // a few priorities make ties common
+    int range = round % 2 ? 4 : 1000;
+
+    for (int step = 0; step < STEPS && !failed; ++step) {
+      int key = randomKey(&model);
+      bool keepHead = rand() % 2;
+      int operation = rand() % 6;
+
+      if (operation <= 1 || key == -1) {
+        // insert a key that isn't in the queue
+        if (model.length == KEYS) {
+          continue;
+        }
+        key = rand() % KEYS;
+        while (model.alive[key]) {
+          key = (key + 1) % KEYS;
+        }
+        int value = rand();
+        int priority = rand() % range;
+        model.alive[key] = true;
+        model.priority[key] = priority;
+        model.order[key] = model.count++;
+        model.value[key] = value;
+        model.length += 1;
+        enqueueKeyPQ(priorityQueue, key, &value, priority, keepHead);
+        placeModel(&model, key, keepHead);
+      } else if (operation == 2) {
+        int priority = rand() % range;
+        model.priority[key] = priority;
+        if (!updateKeyPQ(priorityQueue, key, priority, keepHead)) {
+          fail(round, step, "update missed");
+        }
+        placeModel(&model, key, keepHead);
+      } else if (operation == 3) {
+        if (!removeKeyPQ(priorityQueue, key)) {
+          fail(round, step, "remove missed");
+        }
+        removeModel(&model, key);
+      } else if (operation == 4) {
+        // like a core stealing any node it finds
+        int i = rand() % priorityQueue->length;
+        key = priorityQueue->nodes[i].key;
+        removeAtPQ(priorityQueue, i);
+        removeModel(&model, key);
+      } else {
+        int value;
+        int *data = &value;
+        dequeuePQ(priorityQueue, (void **)&data);
+        if (value != model.value[model.head]) {
+          fail(round, step, "dequeued value");
+        }
+        removeModel(&model, model.head);
+      }
+      checkHeap(priorityQueue, &model, round, step);
+    }
+
+    // whatever is left comes out in the order of the model
+    int value;
+    int *data = &value;
+    while (!failed && dequeuePQ(priorityQueue, (void **)&data)) {
+      if (value != model.value[model.head]) {
+        fail(round, STEPS, "drained value");
+      }
+      removeModel(&model, model.head);
+    }
+    deletePriorityQueue(priorityQueue);
+  }
+
+  printf("priority queue %s\n", failed ? "DIFFERENT" : "same");
+  return failed ? 1 : 0;
+}
@@ -1,28 +1,47 @@
 #ifndef __PRIORITY_QUEUE_H
 #define __PRIORITY_QUEUE_H
 
+#include "pool.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PRIORITY_QUEUE_SIZE 16
+
 /**
  * @brief  Struct used to represent one element
  *         in a priority queue.
+ *         ORDER is the number of elements inserted before it
+ *         and breaks ties between equal priorities.
+ *         KEY is the key it was inserted with or -1 if it has none.
  */
 typedef struct PriorityNode {
   void *data;
   int priority;
-  struct PriorityNode *next;
+  int key;
+  unsigned long order;
 } PriorityNode;
 
 /**
  * @brief  Struct used to represent a collection of elements
- *         arranged based on their priority value
+ *         arranged based on their priority value.
+ *         The nodes are kept in one array as a binary heap,
+ *         the head is always nodes[0] and the children of
+ *         node i are nodes 2i + 1 and 2i + 2.
+ *         Nodes inserted with a key (like a process id) can be found
+ *         in constant time, POSITIONS holds the index of the node
+ *         with each key or -1 if there's none.
+ *         The node data is kept in blocks from the queue's own pool.
  */
 typedef struct PriorityQueue {
-  PriorityNode *head;
+  PriorityNode *nodes;
   size_t size;
   int length;
+  int capacity;
+  unsigned long count;
+  int *positions;
+  int positionsSize;
+  Pool pool;
 } PriorityQueue;
 
 /**
@@ -33,9 +52,15 @@ typedef struct PriorityQueue {
  */
 PriorityQueue* newPriorityQueue(size_t size) {
   PriorityQueue *priorityQueue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
-  priorityQueue->head = NULL;
+  priorityQueue->nodes =
+      (PriorityNode *)malloc(PRIORITY_QUEUE_SIZE * sizeof(PriorityNode));
   priorityQueue->size = size;
   priorityQueue->length = 0;
+  priorityQueue->capacity = PRIORITY_QUEUE_SIZE;
+  priorityQueue->count = 0;
+  priorityQueue->positions = NULL;
+  priorityQueue->positionsSize = 0;
+  initPool(&priorityQueue->pool, size);
   return priorityQueue;
 }
 
@@ -45,19 +70,193 @@ PriorityQueue* newPriorityQueue(size_t size) {
  * @param  PRIORITY_QUEUE the priority queue to be freed.
  */
 void deletePriorityQueue(PriorityQueue *priorityQueue) {
-  PriorityNode *node = priorityQueue->head;
-  for (int i = 0; i < priorityQueue->length; ++i) {
-    PriorityNode *prev = node;
-    node = node->next;
-    free(prev->data);
-    free(prev);
-  }
+  clearPool(&priorityQueue->pool);
+  free(priorityQueue->nodes);
+  free(priorityQueue->positions);
   free(priorityQueue);
 }
 
+/**
+ * @brief  Returns True if node A should come before node B, which is
+ *         when it has a higher priority or was inserted before it.
+ *
+ * @param  A pointer to the first node.
+ * @param  B pointer to the second node.
+ */
+bool beforePQ(PriorityNode *a, PriorityNode *b) {
+  if (a->priority != b->priority) {
+    return a->priority > b->priority;
+  }
+  return a->order < b->order;
+}
+
+/**
+ * @brief  Puts NODE at index I and records its new position.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index to put the node at.
+ * @param  NODE the node to be put.
+ */
+void setPQ(PriorityQueue *priorityQueue, int i, PriorityNode node) {
+  priorityQueue->nodes[i] = node;
+  if (node.key >= 0) {
+    priorityQueue->positions[node.key] = i;
+  }
+}
+
+/**
+ * @brief  Swaps the nodes at indices I and J.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index of the first node.
+ * @param  J index of the second node.
+ */
+void swapPQ(PriorityQueue *priorityQueue, int i, int j) {
+  PriorityNode node = priorityQueue->nodes[i];
+  setPQ(priorityQueue, i, priorityQueue->nodes[j]);
+  setPQ(priorityQueue, j, node);
+}
+
+/**
+ * @brief  Returns the index of the node with key KEY
+ *         or -1 if there's no such node.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  KEY key of the node.
+ */
+int findPQ(PriorityQueue *priorityQueue, int key) {
+  if (key < 0 || key >= priorityQueue->positionsSize) {
+    return -1;
+  }
+  return priorityQueue->positions[key];
+}
+
+/**
+ * @brief  Moves the node at index I up until its parent comes before it
+ *         and returns its new index. It never moves a node into the head,
+ *         that's left to the caller which knows if the head is kept.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index of the node.
+ */
+int siftUpPQ(PriorityQueue *priorityQueue, int i) {
+  while (i > 2) {
+    int parent = (i - 1) / 2;
+    if (!beforePQ(priorityQueue->nodes + i, priorityQueue->nodes + parent)) {
+      break;
+    }
+    swapPQ(priorityQueue, i, parent);
+    i = parent;
+  }
+  return i;
+}
+
+/**
+ * @brief  Moves the node at index I down until it comes before both
+ *         of its children and returns its new index.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index of the node.
+ */
+int siftDownPQ(PriorityQueue *priorityQueue, int i) {
+  while (true) {
+    int first = i;
+    int left = 2 * i + 1;
+    int right = left + 1;
+    if (left < priorityQueue->length &&
+        beforePQ(priorityQueue->nodes + left, priorityQueue->nodes + first)) {
+      first = left;
+    }
+    if (right < priorityQueue->length &&
+        beforePQ(priorityQueue->nodes + right, priorityQueue->nodes + first)) {
+      first = right;
+    }
+    if (first == i) {
+      return i;
+    }
+    swapPQ(priorityQueue, i, first);
+    i = first;
+  }
+}
+
+/**
+ * @brief  Moves the node at index I to where its priority belongs and
+ *         returns its new index. It only takes the place of the head
+ *         if it comes before it and KEEP_HEAD is false.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index of the node.
+ * @param  KEEP_HEAD if set to true, then we don't change the head of the priority queue.
+ */
+int placePQ(PriorityQueue *priorityQueue, int i, bool keepHead) {
+  if (i == 0) {
+    return keepHead ? 0 : siftDownPQ(priorityQueue, 0);
+  }
+
+  if (keepHead || !beforePQ(priorityQueue->nodes + i, priorityQueue->nodes)) {
+    return siftDownPQ(priorityQueue, siftUpPQ(priorityQueue, i));
+  }
+
+  // the head that was replaced might have been kept before,
+  // so it has to find its own place among the other nodes
+  swapPQ(priorityQueue, 0, i);
+  siftDownPQ(priorityQueue, siftUpPQ(priorityQueue, i));
+  return 0;
+}
+
+/**
+ * @brief  Inserts a new node to the priority queue depending on their priority value
+ *         containing the data provided inside DATA that can be found later by KEY.
+ *         Nodes with equal priority keep the order they were inserted in.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  KEY non negative integer to find the node by, or -1 for no key.
+ * @param  DATA pointer to the data to be inserted.
+ * @param  PRIORITY integer value representing the priority of the inserted node.
+ * @param  KEEP_HEAD if set to true, then we don't change the head of the priority queue.
+ */
+void enqueueKeyPQ(PriorityQueue *priorityQueue, int key, void *data, int priority,
+                  bool keepHead) {
+  if (priorityQueue->length == priorityQueue->capacity) {
+    priorityQueue->capacity *= 2;
+    priorityQueue->nodes = (PriorityNode *)realloc(
+        priorityQueue->nodes, priorityQueue->capacity * sizeof(PriorityNode));
+  }
+
+  if (key >= priorityQueue->positionsSize) {
+    int size = priorityQueue->positionsSize ? priorityQueue->positionsSize
+                                            : PRIORITY_QUEUE_SIZE;
+    while (size <= key) {
+      size *= 2;
+    }
+    priorityQueue->positions =
+        (int *)realloc(priorityQueue->positions, size * sizeof(int));
+    for (int i = priorityQueue->positionsSize; i < size; ++i) {
+      priorityQueue->positions[i] = -1;
+    }
+    priorityQueue->positionsSize = size;
+  }
+
+  PriorityNode node;
+  node.data = allocatePool(&priorityQueue->pool);
+  node.priority = priority;
+  node.key = key;
+  node.order = priorityQueue->count++;
+
+  memcpy(node.data, data, priorityQueue->size);
+
+  int i = priorityQueue->length;
+  setPQ(priorityQueue, i, node);
+  priorityQueue->length += 1;
+  if (i) {
+    placePQ(priorityQueue, i, keepHead);
+  }
+}
+
 /**
  * @brief  Inserts a new node to the priority queue depending on their priority value
  *         containing the data provided inside DATA.
+ *         Nodes with equal priority keep the order they were inserted in.
  *
  * @param  PRIORITY_QUEUE pointer to the priority queue.
  * @param  DATA pointer to the data to be inserted.
@@ -65,32 +264,75 @@ void deletePriorityQueue(PriorityQueue *priorityQueue) {
  * @param  KEEP_HEAD if set to true, then we don't change the head of the priority queue.
  */
 void enqueuePQ(PriorityQueue *priorityQueue, void *data, int priority, bool keepHead) {
-  PriorityNode *start = priorityQueue->head;
-  PriorityNode *node = (PriorityNode *)malloc(sizeof(PriorityNode));
-  node->data = malloc(priorityQueue->size);
-  node->priority = priority;
+  enqueueKeyPQ(priorityQueue, -1, data, priority, keepHead);
+}
 
-  memcpy(node->data, data, priorityQueue->size);
-  priorityQueue->length += 1;
+/**
+ * @brief  Changes the priority of the node with key KEY to PRIORITY
+ *         and returns True if there was such a node.
+ *         The node moves to where its new priority belongs, a head
+ *         only stays the head while it still comes before the other
+ *         nodes, unless KEEP_HEAD is set.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  KEY key of the node.
+ * @param  PRIORITY new priority of the node.
+ * @param  KEEP_HEAD if set to true, then we don't change the head of the priority queue.
+ */
+bool updateKeyPQ(PriorityQueue *priorityQueue, int key, int priority, bool keepHead) {
+  int i = findPQ(priorityQueue, key);
+  if (i < 0) {
+    return false;
+  }
 
-  if (priorityQueue->head == NULL) {
-    node->next = NULL;
-    priorityQueue->head = node;
-    return;
+  priorityQueue->nodes[i].priority = priority;
+  placePQ(priorityQueue, i, keepHead);
+  return true;
+}
+
+/**
+ * @brief  Removes the node at index I and releases its data.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  I index of the node.
+ */
+void removeAtPQ(PriorityQueue *priorityQueue, int i) {
+  PriorityNode *node = priorityQueue->nodes + i;
+  if (node->key >= 0) {
+    priorityQueue->positions[node->key] = -1;
   }
+  releasePool(&priorityQueue->pool, node->data);
 
-  if (start->priority < priority && !keepHead) {
-    node->next = start;
-    priorityQueue->head = node;
+  priorityQueue->length -= 1;
+  if (i == priorityQueue->length) {
     return;
   }
 
-  while (start->next != NULL && start->next->priority >= priority) {
-    start = start->next;
+  // the last node fills the gap, a removed head is
+  // replaced by the node that comes first after it
+  setPQ(priorityQueue, i, priorityQueue->nodes[priorityQueue->length]);
+  if (i == 0) {
+    siftDownPQ(priorityQueue, 0);
+  } else {
+    placePQ(priorityQueue, i, true);
+  }
+}
+
+/**
+ * @brief  Removes the node with key KEY from a priority queue and
+ *         returns True if there was such a node.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ * @param  KEY key of the node.
+ */
+bool removeKeyPQ(PriorityQueue *priorityQueue, int key) {
+  int i = findPQ(priorityQueue, key);
+  if (i < 0) {
+    return false;
   }
 
-  node->next = start->next;
-  start->next = node;
+  removeAtPQ(priorityQueue, i);
+  return true;
 }
 
 /**
@@ -100,16 +342,11 @@ void enqueuePQ(PriorityQueue *priorityQueue, void *data, int priority, bool keep
  * @param  PRIORITY_QUEUE pointer to the priority queue.
  */
 bool removePQ(PriorityQueue *priorityQueue) {
-  PriorityNode *node = priorityQueue->head;
-
-  if (node == NULL) {
+  if (!priorityQueue->length) {
     return false;
   }
 
-  priorityQueue->head = node->next;
-  priorityQueue->length -= 1;
-
-  free(node);
+  removeAtPQ(priorityQueue, 0);
   return true;
 }
 
@@ -127,9 +364,7 @@ bool removePQ(PriorityQueue *priorityQueue) {
  *         to copy the removed node data to.
  */
 bool dequeuePQ(PriorityQueue *priorityQueue, void **data) {
-  PriorityNode *node = priorityQueue->head;
-
-  if (node == NULL) {
+  if (!priorityQueue->length) {
     return false;
   }
 
@@ -137,7 +372,7 @@ bool dequeuePQ(PriorityQueue *priorityQueue, void **data) {
     *data = malloc(priorityQueue->size);
   }
 
-  memcpy(*data, node->data, priorityQueue->size);
+  memcpy(*data, priorityQueue->nodes[0].data, priorityQueue->size);
 
   return removePQ(priorityQueue);
 }
@@ -154,9 +389,7 @@ bool dequeuePQ(PriorityQueue *priorityQueue, void **data) {
  *         to copy the head node data to.
  */
 bool peekPQ(PriorityQueue *priorityQueue, void **data) {
-  PriorityNode *node = priorityQueue->head;
-
-  if (node == NULL) {
+  if (!priorityQueue->length) {
     return false;
   }
 
@@ -164,9 +397,33 @@ bool peekPQ(PriorityQueue *priorityQueue, void **data) {
     *data = malloc(priorityQueue->size);
   }
 
-  memcpy(*data, node->data, priorityQueue->size);
+  memcpy(*data, priorityQueue->nodes[0].data, priorityQueue->size);
 
   return true;
 }
 
+/**
+ * @brief  Returns a pointer to the head node data of a priority queue
+ *         or NULL if it's empty, without copying it.
+ *         The pointer is only valid until that node is removed.
+ *
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ */
+void* borrowPQ(PriorityQueue *priorityQueue) {
+  return priorityQueue->length ? priorityQueue->nodes[0].data : NULL;
+}
+
+/**
+ * @brief  Loops over the nodes of a priority queue with NODE pointing
+ *         to each of them in turn. The head comes first, the rest
+ *         come in no particular order.
+ *         The queue must not change inside the loop.
+ *
+ * @param  NODE name of the node pointer.
+ * @param  PRIORITY_QUEUE pointer to the priority queue.
+ */
+#define FOR_EACH_PQ(NODE, PRIORITY_QUEUE)                         \
+  for (PriorityNode *NODE = (PRIORITY_QUEUE)->nodes;              \
+       NODE < (PRIORITY_QUEUE)->nodes + (PRIORITY_QUEUE)->length; ++NODE)
+
 #endif
@@ -1,22 +1,22 @@
 #include "headers.h"
 
 void cont(int);
+static inline void runWorker(int, int);
 
 int remain;
 bool started = false;
 
 int main(int argc, char *argv[]) {
-  signal(SIGCONT, cont);
-
-  int procsemid = semget(PROCSEMKEY, 1, 0444);
-  while ((int)procsemid == -1) {
-    printf("Wait! The semaphore not initialized yet!\n");
-    sleep(1);
-    procsemid = semget(PROCSEMKEY, 1, 0444);
+  // the scheduler starts us as a worker of its pool
+  // with the segment and index of our slot
+  if (argc == 4 && !strcmp(argv[1], "-w")) {
+    initClk();
+    runWorker(atoi(argv[2]), atoi(argv[3]));
   }
 
+  signal(SIGCONT, cont);
+
   if (argc < 2) {
-    down(procsemid);
     printf("Too few arguments!\n");
     exit(-1);
   }
@@ -24,18 +24,22 @@ int main(int argc, char *argv[]) {
   initClk();
   remain = atoi(argv[1]);
 
-  down(procsemid);
+  // keep SIGCONT blocked until we sleep on it
+  // so it can't arrive between checking and sleeping
+  sigset_t mask, oldMask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCONT);
+  sigprocmask(SIG_BLOCK, &mask, &oldMask);
 
   while (!started) {
-    usleep(DELAY_TIME);
+    sigsuspend(&oldMask);
   }
+  sigprocmask(SIG_SETMASK, &oldMask, NULL);
 
   while (remain > 0) {
     int tick = getClk();
     --remain;
-    while (tick == getClk()) {
-      usleep(DELAY_TIME);
-    }
+    waitNextTick(tick);
   }
 
   // printf("Process %d died at %d\n", getpid(),
@@ -49,3 +53,42 @@ int main(int argc, char *argv[]) {
 void cont(int signum) {
   started = true;
 }
+
+/*
+ * Runs jobs handed to us by the scheduler through our slot one after
+ * the other, each job is run exactly like a standalone process would.
+ * The scheduler still stops and continues us with signals while a job
+ * runs, between jobs we just sleep on the slot.
+ */
+static inline void runWorker(int shmid, int index) {
+  WorkerSlot *slots = (WorkerSlot *)shmat(shmid, (void *)0, 0);
+  if ((long)slots == -1) {
+    perror("Error in attaching the worker pool!");
+    exit(-1);
+  }
+  WorkerSlot *slot = slots + index;
+
+  int job = 0;
+  while (true) {
+    int value;
+    while ((value = slot->job) == job) {
+      futexWait(&slot->job, value, 0);
+    }
+    __sync_synchronize();
+    job = value;
+    remain = slot->runtime;
+
+    while ((value = slot->started) != job) {
+      futexWait(&slot->started, value, 0);
+    }
+
+    while (remain > 0) {
+      int tick = getClk();
+      --remain;
+      waitNextTick(tick);
+    }
+
+    __sync_synchronize();
+    slot->done = job;
+  }
+}
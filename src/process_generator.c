@@ -4,53 +4,50 @@ void clearResources(int);
 
 static inline void setupIPC();
 static inline void getInput(char*);
+static inline pid_t spawn(char*, char**, int, char**, int);
 
 int shmid;
-int bufsemid;
-int *bufferaddr;
+void *bufferaddr;
+
+RingBuffer *arrivals = NULL;
 
 Deque *processes = NULL;
 
 int main(int argc, char *argv[]) {
-  pid_t pid;
+  int first = parseOptions(argc, argv);
 
   processes = newDeque(sizeof(Process));
 
   setupIPC();
 
-  int *messageCount = (int *)bufferaddr;
-  Process *buffer = (Process *)((void *)bufferaddr + sizeof(int));
-
   signal(SIGINT, clearResources);
 
-  if (argc < 4) {
+  if (argc - first < 3) {
     printf("Too few arguments!\n");
     printHelp();
     exit(-1);
   }
 
-  SCHEDULING_ALGORITHM sch = atoi(argv[2]);
-  MEMORY_ALLOCATION_ALGORTHIM mem = atoi(argv[3]);
+  SCHEDULING_ALGORITHM sch = atoi(argv[first + 1]);
+  MEMORY_ALLOCATION_ALGORTHIM mem = atoi(argv[first + 2]);
 
-  if (sch < FCFS || sch > RR || mem < FIRSTFIT || mem > BUDDY) {
+  if (sch < FCFS || sch > CFS || mem < FIRSTFIT || mem > PAGING) {
     printf("Invalid scheduling algorithm!\n");
     printHelp();
     exit(-1);
   }
 
-  getInput(argv[1]);
+  getInput(argv[first]);
+
+  // drop the clock of a run that didn't exit cleanly
+  // so its tick barrier can't leak into this one
+  shmctl(shmget(SHKEY, 0, 0444), IPC_RMID, (struct shmid_ds *)0);
 
   // start the clock process
-  pid = fork();
-  if (!pid) {
-    execl("clk.out", "clk.out", NULL);
-  }
+  spawn("clk.out", NULL, 0, argv, first);
 
   // start the scheduler process
-  pid = fork();
-  if (!pid) {
-    execl("scheduler.out", "scheduler.out", argv[2], argv[3], NULL);
-  }
+  spawn("scheduler.out", argv + first + 1, 2, argv, first);
 
   // initialize the clock counter
   initClk();
@@ -59,17 +56,18 @@ int main(int argc, char *argv[]) {
   Process *currentProcess = NULL;
   int endtime = getClk();
   while (processes->length) {
-    down(bufsemid);
     int tick = getClk();
     while (peekFront(processes, (void **)&currentProcess)) {
-      if (currentProcess->arrival <= getClk()) {
+      if (currentProcess->arrival <= tick) {
         removeFront(processes);
-        while (*messageCount >= BUFFER_SIZE) {
-          up(bufsemid);
-          usleep(DELAY_TIME);
-          down(bufsemid);
+        // if the buffer is full let the scheduler know and wait for
+        // it to make room, it wakes us up after draining but we
+        // check again every DELAY_TIME in case it drained right
+        // before we slept
+        while (!pushRB(arrivals, currentProcess)) {
+          signalEvent();
+          futexWait((int *)&arrivals->head, arrivals->head, DELAY_TIME);
         }
-        memcpy(buffer + (*messageCount)++, currentProcess, sizeof(Process));
         endtime = (currentProcess->arrival > endtime) ? currentProcess->arrival
                                                       : endtime;
         endtime += currentProcess->runtime;
@@ -77,53 +75,77 @@ int main(int argc, char *argv[]) {
       }
       break;
     }
-    up(bufsemid);
-    while (tick == getClk()) {
-      usleep(DELAY_TIME / 10);
+    // let the scheduler know everything arriving this tick was sent
+    // and tell a virtual clock when the next process arrives,
+    // or that there is nothing left to send
+    if (processes->length) {
+      releaseTick(GENERATOR, tick, currentProcess->arrival);
+    } else {
+      releaseTick(GENERATOR, INT_MAX, INT_MAX);
+    }
+    if (processes->length) {
+      waitNextTick(tick);
     }
   }
   free(currentProcess);
 
-  while (getClk() <= endtime) {
-    usleep(DELAY_TIME);
-  }
+  if (options.virtualTime) {
+    // the clock marks the simulation as finished
+    // once the scheduler has nothing left to do
+    waitFinished();
+  } else {
+    int tick;
+    while ((tick = getClk()) <= endtime) {
+      waitNextTick(tick);
+    }
 
-  // make sure everything ended properly
-  sleep(5);
-  down(bufsemid);
+    // make sure everything ended properly
+    sleep(5);
+  }
 
   clearResources(-1);
 }
 
 static inline void setupIPC() {
-  semun s;
-  s.val = 1;
+  size_t bytes = ringBufferBytes(BUFFER_SIZE, sizeof(Process), false);
 
-  shmid = shmget(BUFKEY, sizeof(int) + sizeof(Process) * BUFFER_SIZE,
-                 IPC_CREAT | 0644);
+  // drop the buffer of a run that didn't exit cleanly
+  // since it might not have the same size
+  shmctl(shmget(BUFKEY, 0, 0444), IPC_RMID, (struct shmid_ds *)0);
+
+  shmid = shmget(BUFKEY, bytes, IPC_CREAT | 0644);
   if ((int)shmid == -1) {
     perror("Error in creating buffer!");
     exit(-1);
   }
 
-  bufferaddr = (int *)shmat(shmid, (void *)0, 0);
+  bufferaddr = shmat(shmid, (void *)0, 0);
   if ((long)bufferaddr == -1) {
     perror("Error in attaching the buffer in process generator!");
     exit(-1);
   }
 
-  *(int *)bufferaddr = 0;
-
-  bufsemid = semget(BUFSEMKEY, 1, 0644 | IPC_CREAT);
-  if ((int)bufsemid == -1) {
-    perror("Error in creating semaphore!");
-    exit(-1);
-  }
+  arrivals = initRingBuffer(bufferaddr, BUFFER_SIZE, sizeof(Process), false);
+}
 
-  if ((int)semctl(bufsemid, 0, SETVAL, s) == -1) {
-    perror("Error in semctl!");
+/*
+ * Forks and executes FILE with the arguments in EXTRA followed by
+ * the option flags, which parseOptions() moved to the front of ARGV.
+ */
+static inline pid_t spawn(char *file, char **extra, int extraCount,
+                          char **argv, int first) {
+  pid_t pid = fork();
+  if (!pid) {
+    char **args = malloc((extraCount + first + 1) * sizeof(char *));
+    args[0] = file;
+    memcpy(args + 1, extra, extraCount * sizeof(char *));
+    memcpy(args + 1 + extraCount, argv + 1, (first - 1) * sizeof(char *));
+    args[extraCount + first] = NULL;
+    execv(file, args);
+    perror("Error in execv!");
     exit(-1);
   }
+  return pid;
 }
 
 static inline void getInput(char *file) {
@@ -141,7 +163,7 @@ static inline void getInput(char *file) {
   while (fscanf(inputFile, " %[^\n]s", line) != EOF) {
     Process process;
     if (line[0] != '#') {
-      if (sscanf(line, "%d\t%d\t%d\t%d\t%d", &(process.id), &(process.arrival),
+      if (sscanf(line, "%d\t%d\t%d\t%d\t%ld", &(process.id), &(process.arrival),
                  &(process.runtime), &(process.priority), &(process.memsize)) < 5) {
         printf("Error in input file line %d!\n", lineNumber);
         exit(-1);
@@ -163,7 +185,6 @@ void clearResources(int signum) {
     if (processes != NULL) {
       deleteDeque(processes);
     }
-    semctl(bufsemid, 0, IPC_RMID);
     shmdt(bufferaddr);
     shmctl(shmid, IPC_RMID, (struct shmid_ds *)0);
     destroyClk(true);
@@ -0,0 +1,465 @@
+#ifndef __RB_TREE_H
+#define __RB_TREE_H
+
+#include "pool.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief  Struct used to represent one element in a red black tree.
+ *         Nodes are ordered by KEY and then by TIE.
+ *         MAX is the biggest VALUE in the subtree of the node,
+ *         which lets searches skip subtrees with no big enough value.
+ *         The data is stored right after the node in the same block.
+ */
+typedef struct RBNode {
+  struct RBNode *left;
+  struct RBNode *right;
+  struct RBNode *parent;
+  long key;
+  long tie;
+  long value;
+  long max;
+  bool red;
+  void *data;
+} RBNode;
+
+/**
+ * @brief  Struct used to represent a balanced binary search tree
+ *         of elements ordered by their keys, so finding, inserting
+ *         and removing an element all take O(log n).
+ *         Its nodes come from its own pool so they are
+ *         recycled instead of being freed and allocated again.
+ *         STEPS counts the nodes its searches went through.
+ */
+typedef struct RBTree {
+  RBNode *root;
+  size_t size;
+  int length;
+  long steps;
+  Pool pool;
+} RBTree;
+
+/**
+ * @brief  Creates and returns a new red black tree
+ *         with node data of size SIZE.
+ *
+ * @param  SIZE size of the node data.
+ */
+RBTree* newRBTree(size_t size) {
+  RBTree *tree = (RBTree *)malloc(sizeof(RBTree));
+  tree->root = NULL;
+  tree->size = size;
+  tree->length = 0;
+  tree->steps = 0;
+  initPool(&tree->pool, alignPool(sizeof(RBNode)) + size);
+  return tree;
+}
+
+/**
+ * @brief  Frees the red black tree and all its nodes.
+ *
+ * @param  TREE the red black tree to be freed.
+ */
+void deleteRBTree(RBTree *tree) {
+  clearPool(&tree->pool);
+  free(tree);
+}
+
+/**
+ * @brief  Compares the keys of node A with KEY and TIE and returns
+ *         a negative number, zero or a positive number if they
+ *         come before, are equal to or come after them.
+ *
+ * @param  A pointer to the node.
+ * @param  KEY key to compare with.
+ * @param  TIE tie breaker to compare with.
+ */
+int compareRB(RBNode *a, long key, long tie) {
+  if (a->key != key) {
+    return a->key < key ? -1 : 1;
+  }
+  if (a->tie != tie) {
+    return a->tie < tie ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief  Recomputes MAX of NODE from its value and its children.
+ *
+ * @param  NODE pointer to the node.
+ */
+void refreshRB(RBNode *node) {
+  long max = node->value;
+  if (node->left != NULL && node->left->max > max) {
+    max = node->left->max;
+  }
+  if (node->right != NULL && node->right->max > max) {
+    max = node->right->max;
+  }
+  node->max = max;
+}
+
+/**
+ * @brief  Recomputes MAX of NODE and all of its ancestors.
+ *
+ * @param  NODE pointer to the node or NULL.
+ */
+void refreshPathRB(RBNode *node) {
+  while (node != NULL) {
+    refreshRB(node);
+    node = node->parent;
+  }
+}
+
+/**
+ * @brief  Puts REPLACEMENT in the place of OLD under the parent of OLD.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  OLD the node to be replaced.
+ * @param  REPLACEMENT the node to replace it or NULL.
+ */
+void replaceRB(RBTree *tree, RBNode *old, RBNode *replacement) {
+  if (old->parent == NULL) {
+    tree->root = replacement;
+  } else if (old == old->parent->left) {
+    old->parent->left = replacement;
+  } else {
+    old->parent->right = replacement;
+  }
+  if (replacement != NULL) {
+    replacement->parent = old->parent;
+  }
+}
+
+/**
+ * @brief  Rotates the subtree of NODE to the left so
+ *         its right child takes its place.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  NODE pointer to the node.
+ */
+void rotateLeftRB(RBTree *tree, RBNode *node) {
+  RBNode *child = node->right;
+  node->right = child->left;
+  if (child->left != NULL) {
+    child->left->parent = node;
+  }
+  replaceRB(tree, node, child);
+  child->left = node;
+  node->parent = child;
+  refreshRB(node);
+  refreshRB(child);
+}
+
+/**
+ * @brief  Rotates the subtree of NODE to the right so
+ *         its left child takes its place.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  NODE pointer to the node.
+ */
+void rotateRightRB(RBTree *tree, RBNode *node) {
+  RBNode *child = node->left;
+  node->left = child->right;
+  if (child->right != NULL) {
+    child->right->parent = node;
+  }
+  replaceRB(tree, node, child);
+  child->right = node;
+  node->parent = child;
+  refreshRB(node);
+  refreshRB(child);
+}
+
+/**
+ * @brief  Returns True if NODE is red, missing nodes are black.
+ *
+ * @param  NODE pointer to the node or NULL.
+ */
+bool isRedRB(RBNode *node) {
+  return node != NULL && node->red;
+}
+
+/**
+ * @brief  Inserts a new node to the red black tree containing the data
+ *         provided inside DATA and returns it.
+ *         Nodes with equal keys are put after the ones already there.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  KEY key to order the node by.
+ * @param  TIE tie breaker between equal keys.
+ * @param  VALUE value of the node that searches can look for.
+ * @param  DATA pointer to the data to be inserted.
+ */
+RBNode* insertRB(RBTree *tree, long key, long tie, long value, void *data) {
+  RBNode *node = (RBNode *)allocatePool(&tree->pool);
+  node->left = NULL;
+  node->right = NULL;
+  node->key = key;
+  node->tie = tie;
+  node->value = value;
+  node->max = value;
+  node->red = true;
+  node->data = (char *)node + alignPool(sizeof(RBNode));
+  memcpy(node->data, data, tree->size);
+  RBNode *inserted = node;
+
+  RBNode *parent = NULL;
+  RBNode **link = &tree->root;
+  while (*link != NULL) {
+    parent = *link;
+    link = compareRB(parent, key, tie) > 0 ? &parent->left : &parent->right;
+  }
+  node->parent = parent;
+  *link = node;
+  tree->length += 1;
+  refreshPathRB(parent);
+
+  // fix two reds in a row going up the tree
+  while (isRedRB(node->parent)) {
+    parent = node->parent;
+    RBNode *grandparent = parent->parent;
+    bool left = parent == grandparent->left;
+    RBNode *uncle = left ? grandparent->right : grandparent->left;
+    if (isRedRB(uncle)) {
+      parent->red = false;
+      uncle->red = false;
+      grandparent->red = true;
+      node = grandparent;
+      continue;
+    }
+    if (node == (left ? parent->right : parent->left)) {
+      node = parent;
+      left ? rotateLeftRB(tree, node) : rotateRightRB(tree, node);
+      parent = node->parent;
+    }
+    parent->red = false;
+    grandparent->red = true;
+    left ? rotateRightRB(tree, grandparent) : rotateLeftRB(tree, grandparent);
+  }
+  tree->root->red = false;
+
+  return inserted;
+}
+
+/**
+ * @brief  Removes NODE from the red black tree.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  NODE the node to be removed.
+ */
+void removeRB(RBTree *tree, RBNode *node) {
+  RBNode *child;
+  RBNode *parent;
+  bool red = node->red;
+
+  if (node->left == NULL || node->right == NULL) {
+    child = node->left != NULL ? node->left : node->right;
+    parent = node->parent;
+    replaceRB(tree, node, child);
+  } else {
+    // the next node takes the place of the removed one
+    RBNode *next = node->right;
+    while (next->left != NULL) {
+      next = next->left;
+    }
+    red = next->red;
+    child = next->right;
+    if (next->parent == node) {
+      parent = next;
+    } else {
+      parent = next->parent;
+      replaceRB(tree, next, child);
+      next->right = node->right;
+      next->right->parent = next;
+    }
+    replaceRB(tree, node, next);
+    next->left = node->left;
+    next->left->parent = next;
+    next->red = node->red;
+  }
+  refreshPathRB(parent);
+
+  // the side that lost a black node is one black short
+  while (!red && child != tree->root && !isRedRB(child)) {
+    bool left = child == parent->left;
+    RBNode *sibling = left ? parent->right : parent->left;
+    if (isRedRB(sibling)) {
+      sibling->red = false;
+      parent->red = true;
+      left ? rotateLeftRB(tree, parent) : rotateRightRB(tree, parent);
+      sibling = left ? parent->right : parent->left;
+    }
+    RBNode *near = left ? sibling->left : sibling->right;
+    RBNode *far = left ? sibling->right : sibling->left;
+    if (!isRedRB(near) && !isRedRB(far)) {
+      sibling->red = true;
+      child = parent;
+      parent = child->parent;
+      continue;
+    }
+    if (!isRedRB(far)) {
+      near->red = false;
+      sibling->red = true;
+      left ? rotateRightRB(tree, sibling) : rotateLeftRB(tree, sibling);
+      sibling = left ? parent->right : parent->left;
+      far = left ? sibling->right : sibling->left;
+    }
+    sibling->red = parent->red;
+    parent->red = false;
+    far->red = false;
+    left ? rotateLeftRB(tree, parent) : rotateRightRB(tree, parent);
+    child = tree->root;
+  }
+  if (child != NULL) {
+    child->red = false;
+  }
+
+  tree->length -= 1;
+  releasePool(&tree->pool, node);
+}
+
+/**
+ * @brief  Changes the value of NODE to VALUE.
+ *
+ * @param  NODE pointer to the node.
+ * @param  VALUE new value of the node.
+ */
+void updateValueRB(RBNode *node, long value) {
+  node->value = value;
+  refreshPathRB(node);
+}
+
+/**
+ * @brief  Returns the node with keys KEY and TIE or NULL if there's none.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  KEY key of the node.
+ * @param  TIE tie breaker of the node.
+ */
+RBNode* findRB(RBTree *tree, long key, long tie) {
+  RBNode *node = tree->root;
+  while (node != NULL) {
+    int compare = compareRB(node, key, tie);
+    if (!compare) {
+      return node;
+    }
+    node = compare > 0 ? node->left : node->right;
+  }
+  return NULL;
+}
+
+/**
+ * @brief  Returns the first node that doesn't come before KEY and TIE
+ *         or NULL if there's none.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  KEY key to look for.
+ * @param  TIE tie breaker to look for.
+ */
+RBNode* ceilingRB(RBTree *tree, long key, long tie) {
+  RBNode *node = tree->root;
+  RBNode *found = NULL;
+  while (node != NULL) {
+    tree->steps += 1;
+    if (compareRB(node, key, tie) >= 0) {
+      found = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief  Returns the first node in the subtree of NODE with a key
+ *         not less than KEY and a value not less than VALUE
+ *         or NULL if there's none.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  NODE root of the subtree or NULL.
+ * @param  KEY smallest key to look for.
+ * @param  VALUE smallest value to look for.
+ */
+RBNode* fitFromRB(RBTree *tree, RBNode *node, long key, long value) {
+  while (node != NULL && node->max >= value) {
+    tree->steps += 1;
+    if (node->key >= key) {
+      RBNode *found = fitFromRB(tree, node->left, key, value);
+      if (found != NULL) {
+        return found;
+      }
+      if (node->value >= value) {
+        return node;
+      }
+    }
+    node = node->right;
+  }
+  return NULL;
+}
+
+/**
+ * @brief  Returns the first node with a key not less than KEY
+ *         and a value not less than VALUE or NULL if there's none.
+ *
+ * @param  TREE pointer to the red black tree.
+ * @param  KEY smallest key to look for.
+ * @param  VALUE smallest value to look for.
+ */
+RBNode* fitRB(RBTree *tree, long key, long value) {
+  return fitFromRB(tree, tree->root, key, value);
+}
+
+/**
+ * @brief  Returns the first node of the red black tree
+ *         or NULL if it's empty.
+ *
+ * @param  TREE pointer to the red black tree.
+ */
+RBNode* firstRB(RBTree *tree) {
+  RBNode *node = tree->root;
+  while (node != NULL && node->left != NULL) {
+    node = node->left;
+  }
+  return node;
+}
+
+/**
+ * @brief  Returns the last node of the red black tree
+ *         or NULL if it's empty.
+ *
+ * @param  TREE pointer to the red black tree.
+ */
+RBNode* lastRB(RBTree *tree) {
+  RBNode *node = tree->root;
+  while (node != NULL && node->right != NULL) {
+    node = node->right;
+  }
+  return node;
+}
+
+/**
+ * @brief  Returns the node that comes after NODE
+ *         or NULL if it's the last one.
+ *
+ * @param  NODE pointer to the node.
+ */
+RBNode* nextRB(RBNode *node) {
+  if (node->right != NULL) {
+    node = node->right;
+    while (node->left != NULL) {
+      node = node->left;
+    }
+    return node;
+  }
+  while (node->parent != NULL && node == node->parent->right) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+#endif
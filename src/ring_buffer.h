@@ -0,0 +1,199 @@
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief  Struct used to represent a bounded queue that can be shared
+ *         between processes without any locks. It is laid out in one
+ *         block of memory (usually a shared memory segment) and never
+ *         points outside of it.
+ *         HEAD is only written by the consumer and TAIL by the producers,
+ *         each sits on its own cache line so they don't bounce between
+ *         the cores of the producer and the consumer.
+ *         With a single producer the slots only hold the data, with
+ *         multiple producers every slot starts with a sequence number
+ *         that tells whose turn it is to use it.
+ */
+typedef struct RingBuffer {
+  _Alignas(CACHE_LINE_SIZE) unsigned int head;
+  _Alignas(CACHE_LINE_SIZE) unsigned int tail;
+  _Alignas(CACHE_LINE_SIZE) unsigned int capacity;
+  bool multiProducer;
+  size_t size;
+  size_t stride;
+  _Alignas(CACHE_LINE_SIZE) char slots[];
+} RingBuffer;
+
+/**
+ * @brief  Returns the size of one slot of a ring buffer
+ *         with node data of size SIZE.
+ *
+ * @param  SIZE size of the node data.
+ * @param  MULTI_PRODUCER whether slots need a sequence number.
+ */
+size_t ringBufferStride(size_t size, bool multiProducer) {
+  size_t stride = size + (multiProducer ? sizeof(unsigned int) : 0);
+  return (stride + sizeof(long) - 1) & ~(sizeof(long) - 1);
+}
+
+/**
+ * @brief  Returns the number of bytes needed for a ring buffer
+ *         of CAPACITY slots with node data of size SIZE.
+ *
+ * @param  CAPACITY number of slots, must be a power of two.
+ * @param  SIZE size of the node data.
+ * @param  MULTI_PRODUCER whether more than one process pushes.
+ */
+size_t ringBufferBytes(int capacity, size_t size, bool multiProducer) {
+  return sizeof(RingBuffer) + capacity * ringBufferStride(size, multiProducer);
+}
+
+/**
+ * @brief  Creates a new empty ring buffer inside the memory at ADDRESS
+ *         which must be at least ringBufferBytes() long, and returns it.
+ *
+ * @param  ADDRESS memory to create the ring buffer in.
+ * @param  CAPACITY number of slots, must be a power of two.
+ * @param  SIZE size of the node data.
+ * @param  MULTI_PRODUCER whether more than one process pushes.
+ */
+RingBuffer* initRingBuffer(void *address, int capacity, size_t size,
+                           bool multiProducer) {
+  RingBuffer *ringBuffer = (RingBuffer *)address;
+  ringBuffer->head = 0;
+  ringBuffer->tail = 0;
+  ringBuffer->capacity = capacity;
+  ringBuffer->multiProducer = multiProducer;
+  ringBuffer->size = size;
+  ringBuffer->stride = ringBufferStride(size, multiProducer);
+  if (multiProducer) {
+    for (int i = 0; i < capacity; ++i) {
+      *(unsigned int *)(ringBuffer->slots + i * ringBuffer->stride) = i;
+    }
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return ringBuffer;
+}
+
+/**
+ * @brief  Returns a pointer to the slot used by position POSITION.
+ *
+ * @param  RING_BUFFER pointer to the ring buffer.
+ * @param  POSITION head or tail position.
+ */
+char* slotRB(RingBuffer *ringBuffer, unsigned int position) {
+  return ringBuffer->slots +
+         (position & (ringBuffer->capacity - 1)) * ringBuffer->stride;
+}
+
+/**
+ * @brief  Returns the number of nodes in the ring buffer. It's only
+ *         a snapshot if other processes are pushing or popping.
+ *
+ * @param  RING_BUFFER pointer to the ring buffer.
+ */
+int lengthRB(RingBuffer *ringBuffer) {
+  unsigned int head = __atomic_load_n(&ringBuffer->head, __ATOMIC_ACQUIRE);
+  unsigned int tail = __atomic_load_n(&ringBuffer->tail, __ATOMIC_ACQUIRE);
+  return (int)(tail - head);
+}
+
+/**
+ * @brief  Inserts a new node at the tail of a ring buffer containing
+ *         the data provided inside DATA and returns True, or returns
+ *         False without waiting if the ring buffer is full.
+ *         With a single producer it never retries, with multiple
+ *         producers it only retries when another producer won the slot.
+ *
+ * @param  RING_BUFFER pointer to the ring buffer.
+ * @param  DATA pointer to the data to be inserted.
+ */
+bool pushRB(RingBuffer *ringBuffer, void *data) {
+  unsigned int tail = __atomic_load_n(&ringBuffer->tail, __ATOMIC_RELAXED);
+
+  if (!ringBuffer->multiProducer) {
+    unsigned int head = __atomic_load_n(&ringBuffer->head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ringBuffer->capacity) {
+      return false;
+    }
+    memcpy(slotRB(ringBuffer, tail), data, ringBuffer->size);
+    __atomic_store_n(&ringBuffer->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  char *slot;
+  while (true) {
+    slot = slotRB(ringBuffer, tail);
+    unsigned int sequence =
+        __atomic_load_n((unsigned int *)slot, __ATOMIC_ACQUIRE);
+    int difference = (int)(sequence - tail);
+    if (difference == 0) {
+      // the slot is free, try to claim it before another producer does
+      if (__atomic_compare_exchange_n(&ringBuffer->tail, &tail, tail + 1,
+                                      true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // the consumer didn't free this slot yet
+      return false;
+    } else {
+      tail = __atomic_load_n(&ringBuffer->tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(slot + sizeof(unsigned int), data, ringBuffer->size);
+  __atomic_store_n((unsigned int *)slot, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * @brief  Removes the node at the head of a ring buffer and
+ *         returns True if there was a node to remove.
+ *         It copies the removed node data to the memory
+ *         location provided in DATA.
+ *         If NULL is given instead of a memory location
+ *         then it replaces it with a pointer to a copy
+ *         of the removed node data.
+ *         Only one process may pop from a ring buffer.
+ *
+ * @param  RING_BUFFER pointer to the ring buffer.
+ * @param  DATA pointer to memory location
+ *         to copy the removed node data to.
+ */
+bool popRB(RingBuffer *ringBuffer, void **data) {
+  unsigned int head = __atomic_load_n(&ringBuffer->head, __ATOMIC_RELAXED);
+  char *slot = slotRB(ringBuffer, head);
+
+  if (ringBuffer->multiProducer) {
+    unsigned int sequence =
+        __atomic_load_n((unsigned int *)slot, __ATOMIC_ACQUIRE);
+    if ((int)(sequence - (head + 1)) < 0) {
+      return false;
+    }
+    slot += sizeof(unsigned int);
+  } else if (__atomic_load_n(&ringBuffer->tail, __ATOMIC_ACQUIRE) == head) {
+    return false;
+  }
+
+  if (*data == NULL) {
+    *data = malloc(ringBuffer->size);
+  }
+
+  memcpy(*data, slot, ringBuffer->size);
+
+  if (ringBuffer->multiProducer) {
+    // hand the slot back to the producers for the next lap
+    __atomic_store_n((unsigned int *)(slot - sizeof(unsigned int)),
+                     head + ringBuffer->capacity, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&ringBuffer->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+#endif
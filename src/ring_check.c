@@ -0,0 +1,108 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ring_buffer.h"
+
+// checks the ring buffer with producer threads pushing numbered
+// messages and one consumer popping them, every producer's messages
+// have to come out once each and in the order it pushed them
+
+#define PRODUCERS 4
+#define MESSAGES 200000
+#define CAPACITY 64
+// seconds without a message before the consumer gives up
+#define STALL 5
+
+typedef struct Message {
+  int producer;
+  int number;
+} Message;
+
+typedef struct Producer {
+  RingBuffer *ringBuffer;
+  int id;
+} Producer;
+
+/*
+ * Pushes the messages of one producer, spinning while the buffer is full.
+ */
+void *produce(void *argument) {
+  Producer *producer = (Producer *)argument;
+  Message message;
+  message.producer = producer->id;
+  for (message.number = 0; message.number < MESSAGES; ++message.number) {
+    while (!pushRB(producer->ringBuffer, &message)) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Runs PRODUCER_COUNT producers against one consumer and returns
+ * True if every message came out once and in order.
+ */
+bool checkRingBuffer(int producerCount, bool multiProducer) {
+  void *address = aligned_alloc(
+      CACHE_LINE_SIZE, ringBufferBytes(CAPACITY, sizeof(Message),
+                                       multiProducer));
+  RingBuffer *ringBuffer =
+      initRingBuffer(address, CAPACITY, sizeof(Message), multiProducer);
+  pthread_t threads[PRODUCERS];
+  Producer producers[PRODUCERS];
+  int expected[PRODUCERS] = {0};
+  bool same = true;
+
+  for (int i = 0; i < producerCount; ++i) {
+    producers[i].ringBuffer = ringBuffer;
+    producers[i].id = i;
+    pthread_create(&threads[i], NULL, produce, &producers[i]);
+  }
+
+  Message message;
+  Message *data = &message;
+  time_t progress = time(NULL);
+  for (long popped = 0; popped < (long)producerCount * MESSAGES;) {
+    if (!popRB(ringBuffer, (void **)&data)) {
+      // a slot handed back wrong leaves the producers
+      // and the consumer waiting on each other
+      if (time(NULL) - progress > STALL) {
+        same = false;
+        break;
+      }
+      sched_yield();
+      continue;
+    }
+    progress = time(NULL);
+    popped += 1;
+    if (message.producer < 0 || message.producer >= producerCount ||
+        message.number != expected[message.producer]) {
+      same = false;
+      break;
+    }
+    expected[message.producer] += 1;
+  }
+
+  // producers stuck on a broken buffer would never be joined
+  if (!same) {
+    return false;
+  }
+  for (int i = 0; i < producerCount; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  // nothing is left behind once every message came out
+  if (lengthRB(ringBuffer) || popRB(ringBuffer, (void **)&data)) {
+    same = false;
+  }
+  free(address);
+  return same;
+}
+
+int main() {
+  bool single = checkRingBuffer(1, false);
+  bool multiple = checkRingBuffer(PRODUCERS, true);
+
+  printf("ring buffer %s\n", single && multiple ? "same" : "DIFFERENT");
+  return single && multiple ? 0 : 1;
+}
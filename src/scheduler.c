@@ -1,122 +1,240 @@
 #include "headers.h"
 
 static inline void setupIPC();
-static inline void loadBuffer(bool);
+static inline void loadBuffer();
 
 void addProcess(Process*);
+void rejectProcess(int);
 bool tryAllocate(int);
+void freeMemory(int);
+long unitsOf(PCB*);
+long memoryCapacity();
+long largestFree();
+long countHoles(long*);
+long allocationSteps();
+void logMemoryPerf();
+void addWaiting(int);
+void wakeWaiting();
 ProcessInfo startProcess(int);
-void contProcess(ProcessInfo*);
+int spawnWorker();
+int acquireWorker();
+void releaseWorker(int);
+void contProcess(Core*, ProcessInfo*);
+void continueWorker(ProcessInfo*);
 void resumeProcess(ProcessInfo*);
-void stopProcess(ProcessInfo*);
-void removeProcess(ProcessInfo*);
+void stopProcess(Core*, ProcessInfo*);
+void removeProcess(Core*, ProcessInfo*);
+bool runProcess(ProcessInfo*);
+void logProcess(Core*, PCB*, char*, char*);
+int coreLoad(Core*);
+int queuedOn(Core*);
+void assignArrivals();
+void stealWork();
+
+bool swapIn(PCB*);
+void swapOut(PCB*);
+PCB* pickVictim();
+int transferSwap(long);
+long lruScore(PCB*);
+long largestScore(PCB*);
+long priorityScore(PCB*);
 
 void printMemory();
-bool allocate(int, int, int);
-bool deallocate(int, int);
-
-void allocateBM(int, int);
-void deallocateBM(int, int);
-bool checkAllocateBM(int, int);
-
-bool fcfs();
-bool sjf();
-bool hpf();
-bool srtn();
-bool rr();
-
-int firstFit(PCB*);
-int nextFit(PCB*);
-int bestFit(PCB*);
-int buddy(PCB*);
-
-int firstFitBM(PCB*);
-int nextFitBM(PCB*);
+void logMemory(char*, long, int, long, long);
+Node* insertBlock(MemoryNode*);
+void removeBlock();
+bool allocate(Node*, long, int);
+bool deallocate(long);
+bool canCompact(long);
+void compact();
+
+bool fcfs(Core*);
+bool sjf(Core*);
+bool hpf(Core*);
+bool srtn(Core*);
+bool rr(Core*);
+bool mlfq(Core*);
+void pushLevel(Core*, ProcessInfo*, bool);
+void boostLevels(Core*);
+bool cfs(Core*);
+long weightOf(PCB*);
+int sliceOf(Core*, PCB*);
+void updateMinVruntime(Core*);
+
+long firstFit(PCB*);
+long nextFit(PCB*);
+long bestFit(PCB*);
+long buddy(PCB*);
+void unbuddy(PCB*);
+
+long firstFitBM(PCB*);
+long nextFitBM(PCB*);
+void unfitBM(PCB*);
+
+long page(PCB*);
+void unpage(PCB*);
+void logFrames(char*, PCB*);
+void touchPages(Core*, PCB*);
+
+int nextEvent();
+int nextDecision();
+void runSkipped();
 
 void clearResources(int);
 
 int tick;
 
 int shmid;
-int bufsemid;
-int procsemid;
-int *bufferaddr;
+void *bufferaddr;
 
-int *messageCount;
-Process *buffer;
+RingBuffer *arrivals = NULL;
 
-bool bitMap[MEMORY_SIZE];
+// memory is handed out in units of options.granularity bytes
+long memoryUnits;
+BitMap *bitMap = NULL;
+Buddy *buddies = NULL;
+Frames *frames = NULL;
 CircularQueue *memory = NULL;
 Node *memoryHead = NULL;
 Node *memoryLast = NULL;
+// free blocks ordered by size and by start, and all
+// blocks by their start, they all hold pointers to
+// the nodes of the blocks in the memory queue
+RBTree *freeBySize = NULL;
+RBTree *freeByStart = NULL;
+HashMap *blocks = NULL;
+
+// memory telemetry, kept up to date as memory is allocated
+// and freed and written to memory.perf on every tick it changed
+long freeUnits = 0;
+long wastedBytes = 0;
+int allocations = 0;
+long lastSteps = 0;
+bool memoryChanged = false;
+
+// nothing can be allocated until compaction is done moving blocks
+int compactedUntil = 0;
+int nextCompaction = 0;
+int compactions = 0;
+int compactionTicks = 0;
+long relocated = 0;
+
+// processes holding memory in the order they last ran in,
+// the ones not running can be swapped out for another one
+Deque *residents = NULL;
+// how much a swap policy wants to swap a process out, the highest
+// score goes first and ties go to the one that ran the longest ago
+long (*victimScores[SWAP_POLICY_COUNT])(PCB*) = {
+    NULL, lruScore, largestScore, priorityScore};
+// the backing store moves one process at a time
+int swapFreeAt = 0;
+int swapOuts = 0;
+int swapIns = 0;
+int swapTicks = 0;
+long swapped = 0;
 
 Deque *arrived = NULL;
-Deque *waiting = NULL;
+// processes waiting for memory, bucket k has the ones that need
+// more than 2^(k-1) and at most 2^k units in the order they came
+Deque *waiting[WAITING_BUCKETS];
+int waitingLength = 0;
+unsigned long waitingOrder = 0;
+// waiters only need another try once memory was freed
+bool memoryFreed = false;
+
+// a tickless scheduler only runs on ticks it has something to
+// decide in, the running process keeps running from the tick
+// after the last decision until the tick before SKIP_UNTIL
+int lastDecision = 0;
+int skipUntil = 0;
 
 SCHEDULING_ALGORITHM sch;
 MEMORY_ALLOCATION_ALGORTHIM mem;
 
-Deque *deque = NULL;
-PriorityQueue *priorityQueue = NULL;
-CircularQueue *circularQueue = NULL;
-
-ProcessInfo *runningProcess = NULL;
+// every core runs the scheduling algorithm on its own run queue
+Core *cores = NULL;
 PCB **processTable = NULL;
 int processTableSize = PROCESS_TABLE_SIZE;
+Pool pcbs;
+
+Worker *workers = NULL;
+int workerCount = 0;
+int workersSize = 0;
+Deque *idleWorkers = NULL;
+WorkerSlot *workerChunk = NULL;
+int *workerChunkIds = NULL;
 
 int totalCount = 0;
 float totalWTA = 0;
-int totalWait = 0;
-int utilization = 0;
-int lastAllocated = 0;
+long totalWait = 0;
+long lastAllocated = 0;
 
 int main(int argc, char *argv[]) {
-  setupIPC();
+  int first = parseOptions(argc, argv);
 
-  messageCount = (int *)bufferaddr;
-  buffer = (Process *)((void *)bufferaddr + sizeof(int));
+  setupIPC();
 
   processTable = malloc(processTableSize * sizeof(PCB *));
+  initPool(&pcbs, sizeof(PCB));
 
-  MemoryNode *memoryNode = malloc(sizeof(MemoryNode));
-  memoryNode->start = 0;
-  memoryNode->size = MEMORY_SIZE;
-  memoryNode->process = 0;
+  memoryUnits = options.memorySize / options.granularity;
+  freeUnits = memoryUnits;
+  MemoryNode memoryNode;
+  memoryNode.start = 0;
+  memoryNode.size = memoryUnits;
+  memoryNode.process = 0;
 
   memory = newCircularQueue(sizeof(MemoryNode));
-  enqueueCQ(memory, (void *)memoryNode);
-  memoryHead = memory->head;
-  free(memoryNode);
-
-  arrived = newDeque(sizeof(PCB));
-  waiting = newDeque(sizeof(int));
+  freeBySize = newRBTree(sizeof(Node *));
+  freeByStart = newRBTree(sizeof(Node *));
+  blocks = newHashMap(sizeof(Node *));
+  memoryHead = insertBlock(&memoryNode);
+  memoryLast = memoryHead;
+
+  arrived = newDeque(sizeof(ProcessInfo));
+  cores = (Core *)calloc(options.cores, sizeof(Core));
+  for (int i = 0; i < options.cores; ++i) {
+    cores[i].id = i;
+    cores[i].arrived = newDeque(sizeof(ProcessInfo));
+  }
+  residents = newDeque(sizeof(int));
+  for (int i = 0; i < WAITING_BUCKETS; ++i) {
+    waiting[i] = newDeque(sizeof(Waiter));
+  }
 
   signal(SIGINT, clearResources);
 
   initClk();
 
-  if (argc < 3) {
+  if (argc - first < 2) {
     printf("No scheduling algorithm or memory allocation algirthim are provided!\n");
     printMemoryAllocationAlgorthims();
     printSchedulingAlgorithms();
     exit(-1);
   }
 
-  sch = atoi(argv[1]);
-  mem  = atoi(argv[2]);
+  sch = atoi(argv[first]);
+  mem  = atoi(argv[first + 1]);
 
-  if (sch < FCFS || sch > RR ) {
+  if (sch < FCFS || sch > CFS) {
     printf("Invalid scheduling algorithm!\n");
     printSchedulingAlgorithms();
     exit(-1);
   }
 
-  if (mem < FIRSTFIT || mem > BUDDY ) {
+  if (mem < FIRSTFIT || mem > PAGING) {
     printf("Invalid Memory allocation algorithm!\n");
     printMemoryAllocationAlgorthims();
     exit(-1);
   }
 
+  // fork the workers in advance so starting
+  // a process later is just handing it a job
+  idleWorkers = newDeque(sizeof(int));
+  for (int i = 0; !options.inProcess && i < options.poolSize; ++i) {
+    releaseWorker(spawnWorker());
+  }
+
   printf("#At\ttime\tx\tprocess\ty\tstate\t"
          "\tarr\tw\ttotal\tz\tremain\ty\twait\tk\n");
   FILE *pFile = fopen("scheduler.log", "w");
@@ -131,29 +249,59 @@ int main(int argc, char *argv[]) {
                  "for\tprocess\tz\tfrom\ti\tto\tj\n");
   fclose(pFile);
 
-  bool ran = false;
+  pFile = fopen("memory.perf", "w");
+  fprintf(pFile, "#tick\tfree\tlargest\tholes\texternal\t"
+                 "internal\tallocs\tsteps\twaiting\n");
+  fclose(pFile);
+  pFile = fopen("memory.wait", "w");
+  fprintf(pFile, "#process\tarrival\tallocated\twaited\n");
+  fclose(pFile);
+
   while (true) {
-    // ensure the process scheduler sent the new processes
-    usleep(DELAY_TIME);
-    loadBuffer(ran);
+    int events = sharedClock->events;
     tick = getClk();
+    loadBuffer();
+
+    // the generator releases a tick once it sent every process
+    // arriving in it, until then keep loading whatever it sends
+    // so a burst that doesn't fit in the buffer can't block it
+    if (!isReleased(GENERATOR, tick)) {
+      waitEvent(events);
+      continue;
+    }
+
+    if (skipUntil) {
+      runSkipped();
+    }
 
-    if (!ran) {
+    assignArrivals();
+    if (options.cores > 1) {
+      stealWork();
+    }
+    for (int i = 0; i < options.cores; ++i) {
+      Core *core = &cores[i];
+      bool ran;
       switch (sch) {
       case FCFS:
-        ran = fcfs();
+        ran = fcfs(core);
         break;
       case SJF:
-        ran = sjf();
+        ran = sjf(core);
         break;
       case HPF:
-        ran = hpf();
+        ran = hpf(core);
         break;
       case SRTN:
-        ran = srtn();
+        ran = srtn(core);
         break;
       case RR:
-        ran = rr();
+        ran = rr(core);
+        break;
+      case MLFQ:
+        ran = mlfq(core);
+        break;
+      case CFS:
+        ran = cfs(core);
         break;
       default:
         printf("Invalid scheduling algorithm!\n");
@@ -161,91 +309,73 @@ int main(int argc, char *argv[]) {
         exit(-1);
       }
       if (ran) {
-        utilization += 1;
-      }
-
-      int *id = NULL;
-      for (int i = 0; i < waiting->length; ++i) {
-        popFront(waiting, (void **)&id);
-
-        bool allocated = tryAllocate(*id);
-
-        if (allocated) {
-          ProcessInfo newProcess = startProcess(*id);
-          pushBack(arrived, &newProcess);
-        } else {
-          pushBack(waiting, (void *)id);
+        core->utilization += 1;
+        if (mem == PAGING && core->runningProcess != NULL) {
+          touchPages(core, processTable[core->runningProcess->id]);
         }
       }
-      free(id);
+    }
 
-      Node *node = waiting->head;
-      for (int i = 0; i < waiting->length; ++i) {
-        processTable[*((int *)(node->data))]->wait += 1;
-        node = node->next;
+    // compaction makes one big hole out of all the
+    // holes, it's only worth it if there are some
+    if (options.compactPeriod && tick >= nextCompaction) {
+      nextCompaction = tick + options.compactPeriod;
+      if (canCompact(0)) {
+        compact();
       }
     }
+    if (compactedUntil && tick >= compactedUntil) {
+      compactedUntil = 0;
+      memoryFreed = true;
+    }
 
-    int *id = NULL;
-    free(id);
+    if (memoryFreed) {
+      memoryFreed = false;
+      wakeWaiting();
+    }
 
-    while (true) {
-      down(bufsemid);
-      if (*messageCount) {
-        up(bufsemid);
-        break;
-      }
-      usleep(DELAY_TIME);
-      up(bufsemid);
-      if (tick != getClk()) {
-        ran = false;
-        break;
-      }
+    if (memoryChanged) {
+      logMemoryPerf();
+    }
+
+    // a virtual clock also needs to know when we have to run next
+    int next = options.tickless ? nextDecision() : nextEvent();
+    if (options.virtualTime) {
+      releaseTick(SCHEDULER, tick, next);
+    }
+    int clk = waitNextTick(tick);
+    while (options.tickless && clk < next) {
+      clk = waitNextTick(clk);
     }
   }
   clearResources(-1);
 }
 
 static inline void setupIPC() {
-  semun s;
-  s.val = 1;
+  size_t bytes = ringBufferBytes(BUFFER_SIZE, sizeof(Process), false);
 
-  shmid = shmget(BUFKEY, sizeof(int) + sizeof(Process) * BUFFER_SIZE, 0444);
+  shmid = shmget(BUFKEY, bytes, 0444);
   while ((int)shmid == -1) {
     printf("Wait! The buffer not initialized yet!\n");
     sleep(1);
-    shmid = shmget(BUFKEY, sizeof(int) + sizeof(Process) * BUFFER_SIZE, 0444);
+    shmid = shmget(BUFKEY, bytes, 0444);
   }
 
-  bufferaddr = (int *)shmat(shmid, (void *)0, 0);
+  bufferaddr = shmat(shmid, (void *)0, 0);
   if ((long)bufferaddr == -1) {
     perror("Error in attaching the buffer in scheduler!");
     exit(-1);
   }
 
-  bufsemid = semget(BUFSEMKEY, 1, 0444);
-  while ((int)bufsemid == -1) {
-    printf("Wait! The semaphore not initialized yet!\n");
-    sleep(1);
-    bufsemid = semget(BUFSEMKEY, 1, 0444);
-  }
-
-  procsemid = semget(PROCSEMKEY, 1, 0644 | IPC_CREAT);
-  if ((int)procsemid == -1) {
-    perror("Error in creating semaphore!");
-    exit(-1);
-  }
-
-  if ((int)semctl(procsemid, 0, SETVAL, s) == -1) {
-    perror("Error in semctl!");
-    exit(-1);
-  }
+  arrivals = (RingBuffer *)bufferaddr;
 }
 
-static inline void loadBuffer(bool ran) {
-  down(bufsemid);
-  for (int i = 0; i < *messageCount; ++i) {
-    Process *currentProcess = buffer + i;
+static inline void loadBuffer() {
+  Process process;
+  Process *currentProcess = &process;
+  // the generator only sleeps when it found the buffer full
+  bool full = lengthRB(arrivals) >= BUFFER_SIZE;
+  while (popRB(arrivals, (void **)&currentProcess)) {
     // if the new process id exceeds the size of the
     // process table then we need to increase the size
     // of the process table until it can fit
@@ -262,26 +392,35 @@ static inline void loadBuffer(bool ran) {
     addProcess(currentProcess);
     int id = currentProcess->id;
 
-    bool allocated = tryAllocate(id);
-
-    if (ran && allocated) {
-      processTable[id]->wait += 1;
+    // it would wait for memory forever
+    if (unitsOf(processTable[id]) > memoryCapacity()) {
+      rejectProcess(id);
+      continue;
     }
 
-    if (allocated) {
+    bool allocated = tryAllocate(id);
+
+    // with swapping it can get ready without memory
+    // and gets some once it's about to run
+    if (allocated || options.swapPolicy) {
       ProcessInfo newProcess = startProcess(id);
       pushBack(arrived, &newProcess);
     } else {
-      pushBack(waiting, &id);
+      addWaiting(id);
     }
   }
-  up(bufsemid);
-  *messageCount = 0;
+  if (full) {
+    futexWake((int *)&arrivals->head);
+  }
 }
 
 bool tryAllocate(int id) {
     PCB *pcb = processTable[id];
-    int allocated = -1;
+    long allocated = -1;
+    if (tick < compactedUntil) {
+      pcb->memstart = -1;
+      return false;
+    }
     switch (mem) {
     case FIRSTFIT:
       allocated = firstFit(pcb);
@@ -295,17 +434,250 @@ bool tryAllocate(int id) {
     case BUDDY:
       allocated = buddy(pcb);
       break;
+    case FIRSTFIT_BM:
+      allocated = firstFitBM(pcb);
+      break;
+    case NEXTFIT_BM:
+      allocated = nextFitBM(pcb);
+      break;
+    case PAGING:
+      allocated = page(pcb);
+      break;
     default:
       printf("Invalid memory allocation algorithm!\n");
       printMemoryAllocationAlgorthims();
       exit(-1);
     }
     pcb->memstart = allocated;
+    if (allocated != -1) {
+      long units = unitsOf(pcb);
+      char *action = pcb->swapped ? "swapped-in" : "allocated";
+      if (mem == PAGING) {
+        logFrames(action, pcb);
+      } else {
+        logMemory(action, pcb->memsize, pcb->id, allocated, units);
+      }
+      freeUnits -= units;
+      wastedBytes += units * options.granularity - pcb->memsize;
+      allocations += 1;
+      memoryChanged = true;
+      if (options.swapPolicy) {
+        pushBack(residents, &id);
+        pcb->resident = residents->tail;
+      }
+      // only the first time it got memory counts as its wait
+      if (!pcb->swapped) {
+        FILE *pFile = fopen("memory.wait", "a");
+        fprintf(pFile, "%d\t%d\t%d\t%d\n", pcb->id, pcb->arrival, tick,
+                tick - pcb->arrival);
+        fclose(pFile);
+      }
+      pcb->swapped = false;
+    } else if (options.compactOnDemand && canCompact(unitsOf(pcb))) {
+      // it fits in all the holes together so it will after compaction
+      compact();
+    }
     return (allocated != -1);
 }
 
+/*
+ * Gives the memory of a finished or swapped out process
+ * back to the allocation algorithm it came from.
+ */
+void freeMemory(int id) {
+  PCB *pcb = processTable[id];
+  long units = unitsOf(pcb);
+  char *action = pcb->swapped ? "swapped-out" : "freed";
+  if (mem == PAGING) {
+    logFrames(action, pcb);
+  } else {
+    logMemory(action, pcb->memsize, pcb->id, pcb->memstart, units);
+  }
+  if (pcb->resident != NULL) {
+    removeNode(residents, pcb->resident);
+    pcb->resident = NULL;
+  }
+  freeUnits += units;
+  wastedBytes -= units * options.granularity - pcb->memsize;
+  memoryFreed = true;
+  memoryChanged = true;
+  if (mem == BUDDY) {
+    unbuddy(pcb);
+  } else if (mem == FIRSTFIT_BM || mem == NEXTFIT_BM) {
+    unfitBM(pcb);
+  } else if (mem == PAGING) {
+    unpage(pcb);
+  } else {
+    deallocate(pcb->memstart);
+  }
+}
+
+/*
+ * Returns the number of units the memory of a process takes,
+ * the buddy system reserves a whole power of two for it.
+ */
+long unitsOf(PCB *pcb) {
+  long units = (pcb->memsize + options.granularity - 1) / options.granularity;
+  if (units < 1) {
+    units = 1;
+  }
+  return mem == BUDDY ? ceilPowerOfTwo(units) : units;
+}
+
+/*
+ * Returns the most units a process can ever get, the buddy
+ * system can't give more than its largest block.
+ */
+long memoryCapacity() {
+  return mem == BUDDY ? 1l << (63 - __builtin_clzl(memoryUnits)) : memoryUnits;
+}
+
+/*
+ * Returns the size of the largest free block, the bit map doesn't
+ * keep track of it so it goes through its free runs to find it.
+ */
+long largestFree() {
+  switch (mem) {
+  case BUDDY:
+    return buddies->nonEmpty ? 1l << (63 - __builtin_clzl(buddies->nonEmpty))
+                             : 0;
+  case FIRSTFIT_BM:
+  case NEXTFIT_BM:
+    return largestRunBM(bitMap);
+  case PAGING:
+    return freeFrames(frames);
+  default:
+    return freeByStart->root == NULL ? 0 : freeByStart->root->max;
+  }
+}
+
+/*
+ * Returns the number of free blocks and sets LARGEST to the size of
+ * the largest one, the bit map has to go through its free runs for it.
+ */
+long countHoles(long *largest) {
+  switch (mem) {
+  case BUDDY:
+    *largest = largestFree();
+    return buddies->blocks->length;
+  case FIRSTFIT_BM:
+  case NEXTFIT_BM:
+    return runsBM(bitMap, largest);
+  case PAGING:
+    // any free frame can go to any process
+    *largest = freeFrames(frames);
+    return *largest > 0;
+  default:
+    *largest = largestFree();
+    return freeBySize->length;
+  }
+}
+
+/*
+ * Returns the number of steps all the searches for
+ * free memory took so far, in whatever the algorithm
+ * goes through, tree nodes, bit map words, blocks or frames.
+ */
+long allocationSteps() {
+  switch (mem) {
+  case BUDDY:
+    return buddies->steps;
+  case FIRSTFIT_BM:
+  case NEXTFIT_BM:
+    return bitMap->steps;
+  case PAGING:
+    return frames->steps;
+  default:
+    return freeBySize->steps + freeByStart->steps;
+  }
+}
+
+/*
+ * Writes one line to memory.perf with the state of the memory at the
+ * end of a tick it changed in. External fragmentation is the part of
+ * the free memory outside of the largest hole, and internal waste is
+ * the memory allocated to processes beyond what they asked for.
+ */
+void logMemoryPerf() {
+  long largest;
+  long holes = countHoles(&largest);
+  long steps = allocationSteps();
+  float external = freeUnits ? 1 - largest / (float)freeUnits : 0;
+  FILE *pFile = fopen("memory.perf", "a");
+  fprintf(pFile, "%d\t%ld\t%ld\t%ld\t%0.2f\t%ld\t%d\t%ld\t%d\n", tick,
+          freeUnits * options.granularity, largest * options.granularity,
+          holes, external, wastedBytes, allocations, steps - lastSteps,
+          waitingLength);
+  fclose(pFile);
+  lastSteps = steps;
+  allocations = 0;
+  memoryChanged = false;
+}
+
+/*
+ * Puts a process that didn't fit in memory at the
+ * back of the waiters of its size.
+ */
+void addWaiting(int id) {
+  Waiter waiter;
+  waiter.id = id;
+  waiter.order = waitingOrder++;
+  processTable[id]->waitingSince = tick;
+  pushBack(waiting[orderBuddy(unitsOf(processTable[id]))], &waiter);
+  waitingLength += 1;
+}
+
+/*
+ * Tries to allocate memory for the waiting processes in the order they
+ * came, skipping the ones that need more than the largest free block.
+ * Whole buckets are skipped once the largest free block is smaller than
+ * any of their waiters, so only the waiters that could fit are tried.
+ * The largest free block is only looked up again after an allocation,
+ * it's the only thing that changes it here.
+ */
+void wakeWaiting() {
+  if (!waitingLength) {
+    return;
+  }
+  Node *next[WAITING_BUCKETS];
+  for (int i = 0; i < WAITING_BUCKETS; ++i) {
+    next[i] = waiting[i]->head;
+  }
+
+  long largest = largestFree();
+  while (true) {
+    // the oldest waiter not tried yet in the buckets that could fit
+    int bucket = -1;
+    for (int i = 0; i < WAITING_BUCKETS && (!i || 1l << (i - 1) < largest);
+         ++i) {
+      if (next[i] != NULL &&
+          (bucket == -1 || ((Waiter *)next[i]->data)->order <
+                               ((Waiter *)next[bucket]->data)->order)) {
+        bucket = i;
+      }
+    }
+    if (bucket == -1) {
+      break;
+    }
+
+    Node *node = next[bucket];
+    next[bucket] = node->next;
+    int id = ((Waiter *)node->data)->id;
+    if (unitsOf(processTable[id]) <= largest && tryAllocate(id)) {
+      removeNode(waiting[bucket], node);
+      waitingLength -= 1;
+      // the scheduler only takes it in on the next tick so
+      // it doesn't count as waiting in this one either way
+      processTable[id]->wait += tick - processTable[id]->waitingSince;
+      ProcessInfo newProcess = startProcess(id);
+      pushBack(arrived, &newProcess);
+      largest = largestFree();
+    }
+  }
+}
+
 void addProcess(Process *process) {
-  processTable[process->id] = malloc(sizeof(PCB));
+  processTable[process->id] = (PCB *)allocatePool(&pcbs);
   PCB *pcb = processTable[process->id];
   pcb->id = process->id;
   pcb->arrival = process->arrival;
@@ -315,697 +687,1535 @@ void addProcess(Process *process) {
   pcb->remain = process->runtime;
   pcb->execution = 0;
   pcb->wait = 0;
+  pcb->waitingSince = tick;
   pcb->state = WAITING;
   pcb->memsize = process->memsize;
   pcb->memstart = -1;
+  pcb->pageTable = NULL;
+  pcb->cursor = 0;
+  pcb->swapped = false;
+  pcb->swapUntil = 0;
+  pcb->continued = false;
+  pcb->level = 0;
+  pcb->vruntime = 0;
+  pcb->resident = NULL;
+}
+
+/*
+ * Drops a process that needs more memory than there is
+ * instead of letting it wait for memory forever.
+ */
+void rejectProcess(int id) {
+  PCB *pcb = processTable[id];
+  logProcess(NULL, pcb, "rejected", "");
+  releasePool(&pcbs, pcb);
 }
 
 ProcessInfo startProcess(int id) {
   PCB *pcb = processTable[id];
-  char runtime[8];
-  sprintf(runtime, "%d", pcb->runtime);
-  pid_t pid = fork();
-  if (!pid) {
-    execl("process.out", "process.out", runtime, NULL);
-  }
-  // we need to make sure the process has
-  // properly started before we stop it
-  waitzero(procsemid);
-  kill(pid, SIGSTOP);
-  up(procsemid);
   ProcessInfo newProcess;
   newProcess.id = pcb->id;
-  newProcess.pid = pid;
+
+  // simulated processes are nothing more than their pcb
+  // which already keeps track of how much is remaining
+  if (options.inProcess) {
+    newProcess.pid = -1;
+    newProcess.worker = -1;
+    return newProcess;
+  }
+
+  int worker = acquireWorker();
+  WorkerSlot *slot = workers[worker].slot;
+  // the worker waits for the job number to change
+  // so the runtime has to be there before it does
+  slot->runtime = pcb->runtime;
+  __sync_synchronize();
+  slot->job += 1;
+  futexWake(&slot->job);
+  newProcess.pid = workers[worker].pid;
+  newProcess.worker = worker;
   return newProcess;
 }
 
-void contProcess(ProcessInfo *process) {
-  kill(process->pid, SIGCONT);
+/*
+ * Forks a new process.out worker waiting for jobs on its own slot and
+ * returns its index. Slots are allocated in shared memory chunks of
+ * WORKER_CHUNK_SIZE so the pool can keep growing.
+ */
+int spawnWorker() {
+  int index = workerCount % WORKER_CHUNK_SIZE;
+  int chunk = workerCount / WORKER_CHUNK_SIZE;
+  if (!index) {
+    workerChunkIds = realloc(workerChunkIds, (chunk + 1) * sizeof(int));
+    workerChunkIds[chunk] = shmget(IPC_PRIVATE,
+                                   WORKER_CHUNK_SIZE * sizeof(WorkerSlot),
+                                   IPC_CREAT | 0644);
+    if (workerChunkIds[chunk] == -1) {
+      perror("Error in creating the worker pool!");
+      exit(-1);
+    }
+    workerChunk = (WorkerSlot *)shmat(workerChunkIds[chunk], (void *)0, 0);
+    if ((long)workerChunk == -1) {
+      perror("Error in attaching the worker pool!");
+      exit(-1);
+    }
+  }
+
+  // if the new worker doesn't fit then
+  // we double the size of the workers array
+  if (workerCount >= workersSize) {
+    workersSize = workersSize ? workersSize * 2 : WORKER_POOL_SIZE;
+    workers = realloc(workers, workersSize * sizeof(Worker));
+  }
+
+  char shmidArg[16], indexArg[16];
+  sprintf(shmidArg, "%d", workerChunkIds[chunk]);
+  sprintf(indexArg, "%d", index);
+  pid_t pid = fork();
+  if (!pid) {
+    execl("process.out", "process.out", "-w", shmidArg, indexArg, NULL);
+    perror("Error in execl!");
+    exit(-1);
+  }
+  workers[workerCount].pid = pid;
+  workers[workerCount].slot = workerChunk + index;
+  return workerCount++;
+}
+
+/*
+ * Returns the index of an idle worker, forking a new one if
+ * the worker that has been idle the longest is still busy
+ * finishing its last job.
+ */
+int acquireWorker() {
+  int *front = (int *)borrowFront(idleWorkers);
+  if (front != NULL) {
+    int worker = *front;
+    WorkerSlot *slot = workers[worker].slot;
+    if (slot->done == slot->job) {
+      removeFront(idleWorkers);
+      return worker;
+    }
+  }
+  return spawnWorker();
+}
+
+/*
+ * Hands the worker back to the pool once its process finished.
+ */
+void releaseWorker(int worker) {
+  pushBack(idleWorkers, &worker);
+}
+
+void contProcess(Core *core, ProcessInfo *process) {
   PCB *pcb = processTable[process->id];
   pcb->state = RUNNING;
+  // it waited every tick since it got ready but this one
+  pcb->wait += tick - pcb->waitingSince;
+  // without tags the translations of the last process are useless
+  if (mem == PAGING && options.flushTLB && core->tlbOwner != process->id) {
+    flushTLB(core->tlb, 0);
+    core->tlbOwner = process->id;
+  }
+  // the one that ran the longest ago stays at the front
+  if (pcb->resident != NULL) {
+    removeNode(residents, pcb->resident);
+    pushBack(residents, &process->id);
+    pcb->resident = residents->tail;
+  }
+  // its worker is only let run once it runs its first tick
   char *started = "resumed";
   if (pcb->starttime < 0) {
     pcb->starttime = tick;
     started = "started";
   }
-  printf("At\ttime\t%d\tprocess\t%d\t%s\t"
-         "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d\n",
-         tick, process->id, started, pcb->arrival, pcb->runtime, pcb->remain,
-         pcb->wait);
-  FILE *pFile = fopen("scheduler.log", "a");
-  fprintf(pFile,
-          "At\ttime\t%d\tprocess\t%d\t%s\t"
-          "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d\n",
-          tick, process->id, started, pcb->arrival, pcb->runtime, pcb->remain,
-          pcb->wait);
-  fclose(pFile);
+  logProcess(core, pcb, started, "");
 }
 
-void stopProcess(ProcessInfo *process) {
-  kill(process->pid, SIGSTOP);
+/*
+ * Lets the worker of a process run its job, it's handed the job
+ * the first time and only continued after that.
+ */
+void continueWorker(ProcessInfo *process) {
+  WorkerSlot *slot = workers[process->worker].slot;
+  processTable[process->id]->continued = true;
+  if (slot->started != slot->job) {
+    slot->started = slot->job;
+    futexWake(&slot->started);
+  }
+  kill(process->pid, SIGCONT);
+}
+
+void stopProcess(Core *core, ProcessInfo *process) {
   PCB *pcb = processTable[process->id];
+  if (pcb->continued) {
+    kill(process->pid, SIGSTOP);
+    pcb->continued = false;
+  }
   pcb->state = WAITING;
-  printf("At\ttime\t%d\tprocess\t%d\tstopped\t"
-         "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d\n",
-         tick, process->id, pcb->arrival, pcb->runtime, pcb->remain, pcb->wait);
-  FILE *pFile = fopen("scheduler.log", "a");
-  fprintf(pFile,
-          "At\ttime\t%d\tprocess\t%d\tstopped\t"
-          "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d\n",
-          tick, process->id, pcb->arrival, pcb->runtime, pcb->remain,
-          pcb->wait);
-  fclose(pFile);
+  pcb->waitingSince = tick;
+  logProcess(core, pcb, "stopped", "");
 }
 
-void removeProcess(ProcessInfo *process) {
+void removeProcess(Core *core, ProcessInfo *process) {
   PCB *pcb = processTable[process->id];
   float WTA = (tick - pcb->arrival) / (float)(pcb->runtime);
   totalCount += 1;
   totalWTA += WTA;
   totalWait += pcb->wait;
-  printf("At\ttime\t%d\tprocess\t%d\tfinished"
-         "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d"
-         "\tTA\t%d\tWTA\t%0.2f\n",
-         tick, process->id, pcb->arrival, pcb->runtime, pcb->remain, pcb->wait,
-         tick - pcb->arrival, WTA);
-  FILE *pFile = fopen("scheduler.log", "a");
-  fprintf(pFile,
-          "At\ttime\t%d\tprocess\t%d\tfinished"
-          "\tarr\t%d\ttotal\t%d\tremain\t%d\twait\t%d"
-          "\tTA\t%d\tWTA\t%0.2f\n",
-          tick, process->id, pcb->arrival, pcb->runtime, pcb->remain, pcb->wait,
-          tick - pcb->arrival, WTA);
-  fclose(pFile);
-  pFile = fopen("scheduler.perf", "w");
-  fprintf(pFile, "CPU utilization = %0.2f%%\n", 100 * utilization / (float)(tick - 1));
+  char turnaround[64];
+  sprintf(turnaround, "\tTA\t%d\tWTA\t%0.2f", tick - pcb->arrival, WTA);
+  logProcess(core, pcb, "finished", turnaround);
+
+  int utilization = 0;
+  long misses = 0;
+  long lookups = 0;
+  long flushes = 0;
+  for (int i = 0; i < options.cores; ++i) {
+    utilization += cores[i].utilization;
+    if (cores[i].tlb != NULL) {
+      misses += cores[i].tlb->misses;
+      lookups += cores[i].tlb->hits + cores[i].tlb->misses;
+      flushes += cores[i].tlb->flushes;
+    }
+  }
+  FILE *pFile = fopen("scheduler.perf", "w");
+  fprintf(pFile, "CPU utilization = %0.2f%%\n",
+          100 * utilization / (float)(options.cores * (tick - 1)));
+  for (int i = 0; options.cores > 1 && i < options.cores; ++i) {
+    fprintf(pFile, "CPU %d utilization = %0.2f%%\n", i,
+            100 * cores[i].utilization / (float)(tick - 1));
+  }
   fprintf(pFile, "Avg WTA = %0.2f\n", totalWTA / (float)totalCount);
   fprintf(pFile, "Avg Waiting = %0.2f\n", totalWait / (float)totalCount);
+  if (options.compactOnDemand || options.compactPeriod) {
+    fprintf(pFile, "Compactions = %d\n", compactions);
+    fprintf(pFile, "Relocated = %ld bytes in %d ticks\n", relocated,
+            compactionTicks);
+  }
+  if (mem == PAGING) {
+    fprintf(pFile, "TLB misses = %ld of %ld (%0.2f%%)\n", misses,
+            lookups, lookups ? 100 * misses / (float)lookups : 0);
+    fprintf(pFile, "TLB flushes = %ld\n", flushes);
+  }
+  if (options.swapPolicy) {
+    fprintf(pFile, "Swaps = %d out and %d in\n", swapOuts, swapIns);
+    fprintf(pFile, "Swapped = %ld bytes in %d ticks\n", swapped, swapTicks);
+  }
   fclose(pFile);
-  deallocate(pcb->memsize, pcb->id);
-  free(pcb);
+  freeMemory(pcb->id);
+  if (!options.inProcess) {
+    releaseWorker(process->worker);
+  }
+  releasePool(&pcbs, pcb);
+}
+
+/*
+ * Logs a change in the state of a process to stdout and scheduler.log,
+ * EXTRA goes right after the usual columns and the core it's on, if
+ * there's more than one, after that.
+ */
+void logProcess(Core *core, PCB *pcb, char *state, char *extra) {
+  char line[256];
+  int length = sprintf(line, "At\ttime\t%d\tprocess\t%d\t%s%s"
+                             "arr\t%d\ttotal\t%d\tremain\t%d\twait\t%d%s",
+                       tick, pcb->id, state, strlen(state) < 8 ? "\t\t" : "\t",
+                       pcb->arrival, pcb->runtime, pcb->remain, pcb->wait,
+                       extra);
+  if (core != NULL && options.cores > 1) {
+    sprintf(line + length, "\tcpu\t%d", core->id);
+  }
+  printf("%s\n", line);
+  FILE *pFile = fopen("scheduler.log", "a");
+  fprintf(pFile, "%s\n", line);
+  fclose(pFile);
+}
+
+/*
+ * Runs the running process for a tick. A process without memory has
+ * to be swapped in first and it doesn't run until its memory is back,
+ * its worker stays stopped until then.
+ */
+bool runProcess(ProcessInfo *process) {
+  PCB *pcb = processTable[process->id];
+  if (pcb->memstart == -1 && !swapIn(pcb)) {
+    return false;
+  }
+  if (tick < pcb->swapUntil) {
+    return false;
+  }
+  if (!options.inProcess && !pcb->continued) {
+    continueWorker(process);
+  }
+  pcb->remain -= 1;
+  pcb->execution += 1;
+  return true;
+}
+
+/*
+ * Gets memory for a process that is about to run, swapping out other
+ * processes until it fits, and returns False if it can't fit yet.
+ * Its memory is back once the backing store is done with it.
+ */
+bool swapIn(PCB *pcb) {
+  while (!tryAllocate(pcb->id)) {
+    // nothing fits until compaction is done
+    PCB *victim = compactedUntil ? NULL : pickVictim();
+    if (victim == NULL) {
+      return false;
+    }
+    swapOut(victim);
+  }
+  swapIns += 1;
+  pcb->swapUntil = transferSwap(unitsOf(pcb) * options.granularity);
+  return true;
+}
+
+/*
+ * Moves the memory of a process that isn't running to the backing store.
+ */
+void swapOut(PCB *pcb) {
+  swapOuts += 1;
+  transferSwap(unitsOf(pcb) * options.granularity);
+  pcb->swapped = true;
+  freeMemory(pcb->id);
+  pcb->memstart = -1;
+}
+
+/*
+ * Returns the process the swap policy swaps out first or NULL if
+ * there's none, the running process and the ones still being
+ * swapped in can't be swapped out.
+ */
+PCB* pickVictim() {
+  PCB *victim = NULL;
+  long best = 0;
+  FOR_EACH_DEQUE(node, residents) {
+    PCB *pcb = processTable[*(int *)node->data];
+    if (pcb->state == RUNNING || tick < pcb->swapUntil) {
+      continue;
+    }
+    long score = victimScores[options.swapPolicy](pcb);
+    if (victim == NULL || score > best) {
+      victim = pcb;
+      best = score;
+    }
+  }
+  return victim;
+}
+
+/*
+ * Queues BYTES to be moved to or from the backing store
+ * and returns the tick it will be done moving them at.
+ */
+int transferSwap(long bytes) {
+  int start = tick > swapFreeAt ? tick : swapFreeAt;
+  int ticks = options.swapLatency +
+              (bytes + options.swapRate - 1) / options.swapRate;
+  swapTicks += ticks;
+  swapped += bytes;
+  swapFreeAt = start + ticks;
+  return swapFreeAt;
+}
+
+/*
+ * Scores every process the same so the least recently run one goes first.
+ */
+long lruScore(PCB *pcb) {
+  (void)pcb;
+  return 0;
+}
+
+/*
+ * Scores a process by the units it holds so the largest one goes first.
+ */
+long largestScore(PCB *pcb) {
+  return unitsOf(pcb);
+}
+
+/*
+ * Scores a process by its priority so the lowest priority one goes first.
+ */
+long priorityScore(PCB *pcb) {
+  return pcb->priority;
 }
 
 void printMemory() {
-  Node *node = memoryHead;
-  for (int i = 0; i < memory->length; ++i) {
+  FOR_EACH_CQ_FROM(node, memoryHead) {
     MemoryNode *memoryNode = (MemoryNode *)node->data;
-    printf("%d -> %d = %d : %d\n", memoryNode->start,
+    printf("%ld -> %ld = %ld : %d\n", memoryNode->start,
            memoryNode->start + memoryNode->size - 1, memoryNode->size,
            memoryNode->process);
-    node = node->next;
   }
   printf("\n");
 }
 
-bool allocate(int start, int size, int process) {
-  MemoryNode *memoryNode = NULL;
-  int end = start + size - 1;
-  for (int i = 0; i < memory->length; ++i) {
-    moveNext(memory, (void **)&memoryNode);
-    if (memoryNode->start != start) {
-      continue;
-    }
-    if (memoryNode->size < size) {
-      continue;
+/*
+ * Writes one line to memory.log saying that SIZE bytes were
+ * allocated or freed for a process in the UNITS units from
+ * unit START on, the units are written as the bytes they span.
+ */
+void logMemory(char *action, long size, int process, long start, long units) {
+  long from = start * options.granularity;
+  long to = (start + units) * options.granularity - 1;
+  printf("#At\ttime\t%d\t%s\t%ld\tbytes\t"
+         "for\tprocess\t%d\tfrom\t%ld\tto\t%ld\n",
+         tick, action, size, process, from, to);
+  FILE *pFile = fopen("memory.log", "a");
+  fprintf(pFile,
+          "#At\ttime\t%d\t%s\t%ld\tbytes\t"
+          "for\tprocess\t%d\tfrom\t%ld\tto\t%ld\n",
+          tick, action, size, process, from, to);
+  fclose(pFile);
+}
+
+/*
+ * Inserts the block before the head of the memory queue
+ * and indexes it, then returns its node.
+ */
+Node* insertBlock(MemoryNode *memoryNode) {
+  enqueueCQ(memory, (void *)memoryNode);
+  Node *node = memory->head->prev;
+  putHM(blocks, memoryNode->start, &node);
+  if (!memoryNode->process) {
+    insertRB(freeBySize, memoryNode->size, memoryNode->start, 0, &node);
+    insertRB(freeByStart, memoryNode->start, 0, memoryNode->size, &node);
+  }
+  return node;
+}
+
+/*
+ * Removes the block at the head of the memory queue
+ * and takes it out of the indices.
+ */
+void removeBlock() {
+  MemoryNode *memoryNode = (MemoryNode *)memory->head->data;
+  if (!memoryNode->process) {
+    removeRB(freeBySize, findRB(freeBySize, memoryNode->size, memoryNode->start));
+    removeRB(freeByStart, findRB(freeByStart, memoryNode->start, 0));
+  }
+  removeHM(blocks, memoryNode->start);
+  removeCQ(memory);
+}
+
+/*
+ * Allocates SIZE units for a process from the start
+ * of the free block in NODE, the rest of the block
+ * is left free right after it.
+ */
+bool allocate(Node *node, long size, int process) {
+  MemoryNode *memoryNode = (MemoryNode *)node->data;
+  if (memoryNode->process || memoryNode->size < size) {
+    return false;
+  }
+
+  // the node is recycled once it's removed
+  long start = memoryNode->start;
+  long available = memoryNode->size;
+  memory->head = node;
+  removeBlock();
+  MemoryNode newBuffer;
+  MemoryNode *newNode = &newBuffer;
+  newNode->start = start;
+  newNode->size = size;
+  newNode->process = process;
+  memoryLast = insertBlock(newNode);
+  if (!start) {
+    memoryHead = memoryLast;
+  }
+
+  if (available > size) {
+    newNode->start = start + size;
+    newNode->size = available - size;
+    newNode->process = 0;
+    insertBlock(newNode);
+  }
+  return true;
+}
+
+/*
+ * Frees the block that starts at START and merges it with the
+ * blocks right before and after it if they are free, the block
+ * is found through its start so it takes constant time.
+ */
+bool deallocate(long start) {
+  Node **found = (Node **)getHM(blocks, start);
+  if (found == NULL) {
+    return false;
+  }
+  memory->head = *found;
+
+  MemoryNode *memoryNode = (MemoryNode *)memory->head->data;
+  MemoryNode newBuffer;
+  MemoryNode *newNode = &newBuffer;
+  newNode->start = start;
+  newNode->size = memoryNode->size;
+  newNode->process = 0;
+  // removed nodes are recycled so next fit
+  // can't keep pointing at any of them
+  bool last = memory->head == memoryLast;
+  removeBlock();
+  if ((memoryNode = (MemoryNode *)borrowCQ(memory)) != NULL) {
+    if (memoryNode->start > newNode->start && !memoryNode->process) {
+      newNode->size += memoryNode->size;
+      last = last || memory->head == memoryLast;
+      removeBlock();
     }
-    removeCQ(memory);
-    MemoryNode *newNode = malloc(sizeof(MemoryNode));
-    newNode->start = start;
-    newNode->size = size;
-    newNode->process = process;
-    enqueueCQ(memory, (void *)newNode);
-    memoryLast = memory->head->prev;
-    if (!start) {
-      memoryHead = memory->head->prev;
-    }
-
-    printf("#At\ttime\t%d\tallocated\t%d\tbytes\t"
-          "for\tprocess\t%d\tfrom\t%d\tto\t%d\n",
-          tick, size, process, start, start + size - 1);
-    FILE *pFile = fopen("memory.log", "a");
-    fprintf(pFile,
-          "#At\ttime\t%d\tallocated\t%d\tbytes\t"
-          "for\tprocess\t%d\tfrom\t%d\tto\t%d\n",
-          tick, size, process, start, start + size - 1);
-    fclose(pFile);
-
-    if (memoryNode->size > size) {
-      newNode->start = start + size;
-      newNode->size = memoryNode->size - size;
-      newNode->process = 0;
-      enqueueCQ(memory, (void *)newNode);
-    }
-    free(newNode);
-    free(memoryNode);
-    return true;
-  }
-  free(memoryNode);
-  return false;
-}
-
-bool deallocate(int start, int process) {
-  MemoryNode *memoryNode = NULL;
-  for (int i = 0; i < memory->length; ++i) {
-    moveNext(memory, (void **)&memoryNode);
-    if (memoryNode->start != start) {
-      continue;
+  }
+  if ((memoryNode = (MemoryNode *)borrowPrev(memory)) != NULL) {
+    if (memoryNode->start < newNode->start && !memoryNode->process) {
+      newNode->start = memoryNode->start;
+      newNode->size += memoryNode->size;
+      last = last || memory->head == memoryLast;
+      removeBlock();
+    } else {
+      // the freed node goes back right before the node after it
+      borrowNext(memory);
     }
-    removeCQ(memory);
-    MemoryNode *newNode = malloc(sizeof(MemoryNode));
-    newNode->start = start;
-    newNode->size = memoryNode->size;
-    newNode->process = 0;
-    printf("#At\ttime\t%d\tfreed\t%d\tbytes\t"
-          "for\tprocess\t%d\tfrom\t%d\tto\t%d\n",
-          tick, newNode->size, process, start, start + newNode->size - 1);
-    FILE *pFile = fopen("memory.log", "a");
-    fprintf(pFile,
-          "#At\ttime\t%d\tfreed\t%d\tbytes\t"
-          "for\tprocess\t%d\tfrom\t%d\tto\t%d\n",
-          tick, newNode->size, process, start, start + newNode->size - 1);
-    fclose(pFile);
-    if (peekCQ(memory, (void **)&memoryNode)) {
-      if (memoryNode->start > newNode->start) {
-        if (!memoryNode->process) {
-          removeCQ(memory);
-          newNode->size += memoryNode->size;
-        }
-      }
+  }
+  Node *node = insertBlock(newNode);
+  if (!newNode->start) {
+    memoryHead = node;
+  }
+  if (last) {
+    memoryLast = node;
+  }
+  return true;
+}
+
+/*
+ * Returns True if compacting the memory can be done and would leave
+ * a hole of at least SIZE units, which is only the case for the fit
+ * algorithms when the memory has more than one hole.
+ */
+bool canCompact(long size) {
+  if (mem < FIRSTFIT || mem > BESTFIT || compactedUntil) {
+    return false;
+  }
+  return freeBySize->length > 1 && size <= freeUnits;
+}
+
+/*
+ * Slides every allocated block down towards the start of the memory
+ * in the order they are in, so all the holes become one at the end.
+ * Moving memory takes a tick for every relocation rate bytes moved,
+ * and nothing can be allocated until then.
+ */
+void compact() {
+  int count = 0;
+  MemoryNode *resident = malloc(memory->length * sizeof(MemoryNode));
+  FOR_EACH_CQ_FROM(node, memoryHead) {
+    MemoryNode *memoryNode = (MemoryNode *)node->data;
+    if (memoryNode->process) {
+      resident[count++] = *memoryNode;
     }
-    if (movePrev(memory, (void **)&memoryNode)) {
-      if (memoryNode->start < newNode->start) {
-        if (!memoryNode->process) {
-          removeCQ(memory);
-          newNode->start = memoryNode->start;
-          newNode->size += memoryNode->size;
-        }
-      }
+  }
+  while (memory->length) {
+    removeBlock();
+  }
+
+  // the memory queue is empty so the blocks are put back in order
+  long start = 0;
+  long moved = 0;
+  for (int i = 0; i < count; ++i) {
+    if (resident[i].start != start) {
+      PCB *pcb = processTable[resident[i].process];
+      pcb->memstart = start;
+      resident[i].start = start;
+      moved += resident[i].size;
+      logMemory("relocated", pcb->memsize, pcb->id, start, resident[i].size);
     }
-    enqueueCQ(memory, (void *)newNode);
-    if (!newNode->start) {
-      memoryHead = memory->head->prev;
+    start += resident[i].size;
+    memoryLast = insertBlock(resident + i);
+    if (!i) {
+      memoryHead = memoryLast;
     }
-    free(newNode);
-    free(memoryNode);
-    return true;
   }
-  free(memoryNode);
-  return false;
+  if (start < memoryUnits) {
+    MemoryNode hole;
+    hole.start = start;
+    hole.size = memoryUnits - start;
+    hole.process = 0;
+    insertBlock(&hole);
+  }
+  free(resident);
+
+  long bytes = moved * options.granularity;
+  int ticks = (bytes + options.relocationRate - 1) / options.relocationRate;
+  compactions += 1;
+  compactionTicks += ticks;
+  relocated += bytes;
+  compactedUntil = tick + ticks;
+  memoryChanged = true;
 }
 
-bool fcfs() {
+bool fcfs(Core *core) {
   PCB *pcb;
+  ProcessInfo info;
   ProcessInfo *processInfo;
 
   // initialize deque of project info if it's not initialized
-  if (deque == NULL) {
-    deque = newDeque(sizeof(ProcessInfo));
+  if (core->deque == NULL) {
+    core->deque = newDeque(sizeof(ProcessInfo));
   }
 
   // load the newly arrived processes into the deque
-  processInfo = NULL;
-  while (popFront(arrived, (void **)&processInfo)) {
-    pushBack(deque, processInfo);
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
+    pushBack(core->deque, processInfo);
   }
-  free(processInfo);
 
   // if the deque is empty, there is nothing to do
-  if (deque->head == NULL) {
+  if (core->deque->head == NULL) {
     return false;
   }
 
   // if the running process has finished
   // then we need to remove it
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
     if (pcb->remain <= 0) {
-      removeFront(deque);
-      removeProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = NULL;
+      removeFront(core->deque);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
     }
   }
 
   // if we don't have a running process then we
   // should start the next process in the deque
-  if (runningProcess == NULL) {
+  if (core->runningProcess == NULL) {
     // if we don't have a running process
     // and the deque is empty, then there
     // is nothing to do
-    if (!peekFront(deque, (void **)&runningProcess)) {
+    core->runningProcess = &core->current;
+    if (!peekFront(core->deque, (void **)&core->runningProcess)) {
+      core->runningProcess = NULL;
       return false;
     }
-    contProcess(runningProcess);
-  }
-
-  // the head of the deque should be
-  // the currently running process
-  // so we will increase the wait time
-  // of all the processes after the head
-  Node *process = deque->head->next;
-  while (process != NULL) {
-    int id = ((ProcessInfo *)(process->data))->id;
-    processTable[id]->wait += 1;
-    process = process->next;
+    contProcess(core, core->runningProcess);
   }
 
-  // update the pcb of the running process
-  pcb = processTable[runningProcess->id];
-  pcb->remain -= 1;
-  pcb->execution += 1;
-
-  return true;
+  // the running process runs for a tick
+  return runProcess(core->runningProcess);
 }
 
-bool sjf() {
+bool sjf(Core *core) {
   PCB *pcb;
+  ProcessInfo info;
   ProcessInfo *processInfo;
 
   // initialize priority queue of project info if it's not initialized
-  if (priorityQueue == NULL) {
-    priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
+  if (core->priorityQueue == NULL) {
+    core->priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
   }
 
   // if the priority queue is empty, there is nothing to do
-  if (priorityQueue->head == NULL) {
-    if (arrived->head == NULL) {
+  if (core->priorityQueue->length == 0) {
+    if (core->arrived->head == NULL) {
       return false;
     }
   }
 
   // if the running process has finished
   // then we need to remove it
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
     if (pcb->remain <= 0) {
-      removePQ(priorityQueue);
-      removeProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = NULL;
+      removePQ(core->priorityQueue);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
     }
   }
 
   // load the newly arrived processes into the priority queue
-  processInfo = NULL;
-  while (popFront(arrived, (void **)&processInfo)) {
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
     pcb = processTable[processInfo->id];
-    enqueuePQ(priorityQueue, processInfo, -1 * (pcb->runtime), true);
+    enqueuePQ(core->priorityQueue, processInfo, -1 * (pcb->runtime), true);
   }
-  free(processInfo);
 
   // if we don't have a running process then we
   // should start the next process in the priority queue
-  if (runningProcess == NULL) {
+  if (core->runningProcess == NULL) {
     // if we don't have a running process
     // and the priority queue is empty, then there
     // is nothing to do
-    if (!peekPQ(priorityQueue, (void **)&runningProcess)) {
+    core->runningProcess = &core->current;
+    if (!peekPQ(core->priorityQueue, (void **)&core->runningProcess)) {
+      core->runningProcess = NULL;
       return false;
     }
-    contProcess(runningProcess);
-  }
-
-  // the head of the priority queue should be
-  // the currently running process
-  // so we will increase the wait time
-  // of all the processes after the head
-  PriorityNode *process = priorityQueue->head->next;
-  while (process != NULL) {
-    int id = ((ProcessInfo *)(process->data))->id;
-    processTable[id]->wait += 1;
-    process = process->next;
+    contProcess(core, core->runningProcess);
   }
 
-  // we also need to update the wait time
-  // of the processes that arrived
-  Node *arrivedProcess = arrived->head;
-  while (arrivedProcess != NULL) {
-    int id = ((ProcessInfo *)(arrivedProcess->data))->id;
-    processTable[id]->wait += 1;
-    arrivedProcess = arrivedProcess->next;
-  }
-
-  // update the pcb of the running process
-  pcb = processTable[runningProcess->id];
-  pcb->remain -= 1;
-  pcb->execution += 1;
-
-  return true;
+  // the running process runs for a tick
+  return runProcess(core->runningProcess);
 }
 
-bool hpf() {
+bool hpf(Core *core) {
   PCB *pcb;
+  ProcessInfo info;
   ProcessInfo *processInfo;
 
   // initialize priority queue of project info if it's not initialized
-  if (priorityQueue == NULL) {
-    priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
+  if (core->priorityQueue == NULL) {
+    core->priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
   }
 
   // if the priority queue is empty, there is nothing to do
-  if (priorityQueue->head == NULL) {
-    if (arrived->head == NULL) {
+  if (core->priorityQueue->length == 0) {
+    if (core->arrived->head == NULL) {
       return false;
     }
   }
 
   // if the running process has finished
   // then we need to remove it
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
     if (pcb->remain <= 0) {
-      removePQ(priorityQueue);
-      removeProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = NULL;
+      removeKeyPQ(core->priorityQueue, core->runningProcess->id);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
     }
   }
 
   // load the newly arrived processes into the priority queue
-  processInfo = NULL;
-  while (popFront(arrived, (void **)&processInfo)) {
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
     pcb = processTable[processInfo->id];
-    enqueuePQ(priorityQueue, processInfo, -1 * (pcb->priority), false);
+    enqueueKeyPQ(core->priorityQueue, processInfo->id, processInfo,
+                 -1 * (pcb->priority), false);
   }
-  free(processInfo);
 
   // if we don't have a running process then we
   // should start the next process in the priority queue
-  if (runningProcess == NULL) {
+  if (core->runningProcess == NULL) {
     // if we don't have a running process
     // and the priority queue is empty, then there
     // is nothing to do
-    if (!peekPQ(priorityQueue, (void **)&runningProcess)) {
+    core->runningProcess = &core->current;
+    if (!peekPQ(core->priorityQueue, (void **)&core->runningProcess)) {
+      core->runningProcess = NULL;
       return false;
     }
-    contProcess(runningProcess);
+    contProcess(core, core->runningProcess);
   } else {
     // we always switch the running process to the first
     // process in the priority queue
-    processInfo = NULL;
-    peekPQ(priorityQueue, (void **)&processInfo);
-    if (processInfo->id != runningProcess->id) {
-      stopProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = processInfo;
-      contProcess(runningProcess);
-    } else {
-      free(processInfo);
+    processInfo = (ProcessInfo *)borrowPQ(core->priorityQueue);
+    if (processInfo->id != core->runningProcess->id) {
+      stopProcess(core, core->runningProcess);
+      core->current = *processInfo;
+      contProcess(core, core->runningProcess);
     }
   }
 
-  // the head of the priority queue should be
-  // the currently running process
-  // so we will increase the wait time
-  // of all the processes after the head
-  PriorityNode *process = priorityQueue->head->next;
-  while (process != NULL) {
-    int id = ((ProcessInfo *)(process->data))->id;
-    processTable[id]->wait += 1;
-    process = process->next;
-  }
-
-  // update the pcb of the running process
-  pcb = processTable[runningProcess->id];
-  pcb->remain -= 1;
-  pcb->execution += 1;
-
-  return true;
+  // the running process runs for a tick
+  return runProcess(core->runningProcess);
 }
 
-bool srtn(){
+bool srtn(Core *core) {
   PCB *pcb;
+  ProcessInfo info;
   ProcessInfo *processInfo;
 
   // initialize priority queue of project info if it's not initialized
-  if (priorityQueue == NULL) {
-    priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
+  if (core->priorityQueue == NULL) {
+    core->priorityQueue = newPriorityQueue(sizeof(ProcessInfo));
   }
 
   // if the priority queue is empty, there is nothing to do
-  if (priorityQueue->head == NULL) {
-    if (arrived->head == NULL) {
+  if (core->priorityQueue->length == 0) {
+    if (core->arrived->head == NULL) {
       return false;
     }
   }
 
   // if the running process has finished
   // then we need to remove it
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
     if (pcb->remain <= 0) {
-      removePQ(priorityQueue);
-      removeProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = NULL;
+      removeKeyPQ(core->priorityQueue, core->runningProcess->id);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
     }
   }
 
   // we need to change the priority of the running process
   // to the remaining time instead of the total runtime
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
-    priorityQueue->head->priority = -1 * (pcb->remain);
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
+    updateKeyPQ(core->priorityQueue, core->runningProcess->id, -1 * (pcb->remain), false);
   }
 
   // load the newly arrived processes into the priority queue
-  processInfo = NULL;
-  while (popFront(arrived, (void **)&processInfo)) {
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
     pcb = processTable[processInfo->id];
-    enqueuePQ(priorityQueue, processInfo, -1 * (pcb->runtime), false);
+    enqueueKeyPQ(core->priorityQueue, processInfo->id, processInfo,
+                 -1 * (pcb->remain), false);
   }
-  free(processInfo);
 
   // if we don't have a running process then we
   // should start the next process in the priority queue
-  if (runningProcess == NULL) {
+  if (core->runningProcess == NULL) {
     // if we don't have a running process
     // and the priority queue is empty, then there
     // is nothing to do
-    if (!peekPQ(priorityQueue, (void **)&runningProcess)) {
+    core->runningProcess = &core->current;
+    if (!peekPQ(core->priorityQueue, (void **)&core->runningProcess)) {
+      core->runningProcess = NULL;
       return false;
     }
-    contProcess(runningProcess);
+    contProcess(core, core->runningProcess);
   } else {
     // we always switch the running process to the first
     // process in the priority queue
-    processInfo = NULL;
-    peekPQ(priorityQueue, (void **)&processInfo);
-    if (processInfo->id != runningProcess->id) {
-      stopProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = processInfo;
-      contProcess(runningProcess);
-    } else {
-      free(processInfo);
+    processInfo = (ProcessInfo *)borrowPQ(core->priorityQueue);
+    if (processInfo->id != core->runningProcess->id) {
+      stopProcess(core, core->runningProcess);
+      core->current = *processInfo;
+      contProcess(core, core->runningProcess);
     }
   }
 
-  // the head of the priority queue should be
-  // the currently running process
-  // so we will increase the wait time
-  // of all the processes after the head
-  PriorityNode *process = priorityQueue->head->next;
-  while (process != NULL) {
-    int id = ((ProcessInfo *)(process->data))->id;
-    processTable[id]->wait += 1;
-    process = process->next;
-  }
-
-  // update the pcb of the running process
-  pcb = processTable[runningProcess->id];
-  pcb->remain -= 1;
-  pcb->execution += 1;
-
-  return true;
+  // the running process runs for a tick
+  return runProcess(core->runningProcess);
 }
 
-bool rr() {
+bool rr(Core *core) {
   PCB *pcb;
+  ProcessInfo info;
   ProcessInfo *processInfo;
-  static int q = 0;
 
   // initialize circular queue of project info if it's not initialized
-  if (circularQueue == NULL) {
-    circularQueue = newCircularQueue(sizeof(ProcessInfo));
+  if (core->circularQueue == NULL) {
+    core->circularQueue = newCircularQueue(sizeof(ProcessInfo));
   }
 
   // if the circular queue is empty, there is nothing to do
-  if (circularQueue->head == NULL) {
-    if (arrived->head == NULL) {
+  if (core->circularQueue->head == NULL) {
+    if (core->arrived->head == NULL) {
       return false;
     }
   }
 
   // if the running process has finished
   // then we need to remove it
-  if (runningProcess != NULL) {
-    pcb = processTable[runningProcess->id];
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
     if (pcb->remain <= 0) {
-      removeCQ(circularQueue);
-      removeProcess(runningProcess);
-      free(runningProcess);
-      runningProcess = NULL;
-      q = 0;
+      removeCQ(core->circularQueue);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
+      core->quantum = 0;
     }
   }
 
   // load the newly arrived processes into the circular queue
-  processInfo = NULL;
-  while (popFront(arrived, (void **)&processInfo)) {
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
     pcb = processTable[processInfo->id];
-    enqueueCQ(circularQueue, processInfo);
+    enqueueCQ(core->circularQueue, processInfo);
   }
-  free(processInfo);
 
-  if (!q) {
-    if (runningProcess == NULL) {
-      peekCQ(circularQueue, (void **)&runningProcess);
-      contProcess(runningProcess);
+  // the last process might have just finished
+  if (core->circularQueue->head == NULL) {
+    return false;
+  }
+
+  if (!core->quantum && !core->stalled) {
+    if (core->runningProcess == NULL) {
+      core->runningProcess = &core->current;
+      peekCQ(core->circularQueue, (void **)&core->runningProcess);
+      contProcess(core, core->runningProcess);
     } else {
-      processInfo = NULL;
-      moveNext(circularQueue, (void **)&processInfo);
-      if (processInfo->id != runningProcess->id) {
-        stopProcess(runningProcess);
-        free(runningProcess);
-        runningProcess = processInfo;
-        contProcess(runningProcess);
-      } else {
-        free(processInfo);
+      processInfo = (ProcessInfo *)borrowNext(core->circularQueue);
+      if (processInfo->id != core->runningProcess->id) {
+        stopProcess(core, core->runningProcess);
+        core->current = *processInfo;
+        contProcess(core, core->runningProcess);
       }
     }
   }
 
-  q = (q + 1) % QUANTA;
+  // the running process runs for a tick, the time it
+  // waits to be swapped in doesn't use up its quantum
+  core->stalled = !runProcess(core->runningProcess);
+  if (core->stalled) {
+    return false;
+  }
+  core->quantum = (core->quantum + 1) % QUANTA;
+  return true;
+}
 
-  // the head of the circular queue should be
-  // the currently running process
-  // so we will increase the wait time
-  // of all the processes after the head
-  Node *process = circularQueue->head->next;
-  for (int i = 0; i < circularQueue->length - 1; ++i) {
-    int id = ((ProcessInfo *)(process->data))->id;
-    processTable[id]->wait += 1;
-    process = process->next;
+bool mlfq(Core *core) {
+  PCB *pcb;
+  ProcessInfo info;
+  ProcessInfo *processInfo;
+
+  // initialize the levels if they're not initialized
+  if (core->levels == NULL) {
+    core->levels = (Deque **)malloc(options.levels * sizeof(Deque *));
+    for (int i = 0; i < options.levels; ++i) {
+      core->levels[i] = newDeque(sizeof(ProcessInfo));
+    }
   }
 
-  // update the pcb of the running process
-  pcb = processTable[runningProcess->id];
-  pcb->remain -= 1;
-  pcb->execution += 1;
+  // if the running process has finished
+  // then we need to remove it
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
+    if (pcb->remain <= 0) {
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
+      core->quantum = 0;
+    }
+  }
 
+  // every process goes back to the highest level once a boost
+  // period, so the ones on the lowest levels can't starve
+  if (options.boostPeriod && tick / options.boostPeriod != core->boosted) {
+    core->boosted = tick / options.boostPeriod;
+    boostLevels(core);
+  }
+
+  // load the newly arrived processes into their levels, new
+  // ones start at the highest one and stolen ones keep theirs
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
+    pushLevel(core, processInfo, false);
+  }
+
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
+    // the running process used up its quantum and already moved a level
+    // down, it goes behind the others on its level if there are any,
+    // and a process on a higher level takes over right away
+    int first = core->nonEmpty ? __builtin_ctzl(core->nonEmpty) : INT_MAX;
+    bool expired = !core->quantum && !core->stalled;
+    if (first < pcb->level || (expired && first == pcb->level)) {
+      stopProcess(core, core->runningProcess);
+      pushLevel(core, core->runningProcess, !expired);
+      core->runningProcess = NULL;
+      core->quantum = 0;
+      core->stalled = false;
+    }
+  }
+
+  // the next process is the first one on the highest non-empty level
+  if (core->runningProcess == NULL) {
+    if (!core->nonEmpty) {
+      return false;
+    }
+    int level = __builtin_ctzl(core->nonEmpty);
+    core->runningProcess = &core->current;
+    popFront(core->levels[level], (void **)&core->runningProcess);
+    if (!core->levels[level]->length) {
+      core->nonEmpty &= ~(1ul << level);
+    }
+    contProcess(core, core->runningProcess);
+  }
+
+  // the running process runs for a tick, the time it
+  // waits to be swapped in doesn't use up its quantum
+  core->stalled = !runProcess(core->runningProcess);
+  if (core->stalled) {
+    return false;
+  }
+  pcb = processTable[core->runningProcess->id];
+  core->quantum += 1;
+  if (core->quantum >= options.quanta[pcb->level]) {
+    core->quantum = 0;
+    if (pcb->level < options.levels - 1) {
+      pcb->level += 1;
+    }
+  }
   return true;
 }
 
-int firstFitBM(PCB* process){
-  for (int i = 0; i < MEMORY_SIZE; i++) {
-    if (checkAllocateBM(i, process->memsize) != -1) {
-      allocateBM(i, process->memsize);
-      processTable[process->id]->memstart = i;
-      return i;
+/*
+ * Puts a process on its level of a multi-level feedback queue,
+ * at the front of it if FRONT is set or at the back otherwise.
+ */
+void pushLevel(Core *core, ProcessInfo *process, bool front) {
+  int level = processTable[process->id]->level;
+  if (front) {
+    pushFront(core->levels[level], process);
+  } else {
+    pushBack(core->levels[level], process);
+  }
+  core->nonEmpty |= 1ul << level;
+}
+
+/*
+ * Moves the processes on every level of a multi-level feedback queue
+ * to the back of the highest one, keeping the order of the levels,
+ * and the running process to the highest level too.
+ */
+void boostLevels(Core *core) {
+  ProcessInfo info;
+  ProcessInfo *processInfo = &info;
+  unsigned long levels = core->nonEmpty & ~1ul;
+  while (levels) {
+    int level = __builtin_ctzl(levels);
+    levels &= levels - 1;
+    while (popFront(core->levels[level], (void **)&processInfo)) {
+      processTable[processInfo->id]->level = 0;
+      pushLevel(core, processInfo, false);
     }
   }
-  return -1;
+  core->nonEmpty &= 1ul;
+  if (core->runningProcess != NULL) {
+    processTable[core->runningProcess->id]->level = 0;
+  }
 }
 
+bool cfs(Core *core) {
+  PCB *pcb;
+  ProcessInfo info;
+  ProcessInfo *processInfo;
+
+  // initialize the timeline if it's not initialized
+  if (core->timeline == NULL) {
+    core->timeline = newRBTree(sizeof(ProcessInfo));
+  }
+
+  // if the running process has finished
+  // then we need to remove it
+  if (core->runningProcess != NULL) {
+    pcb = processTable[core->runningProcess->id];
+    if (pcb->remain <= 0) {
+      core->weight -= weightOf(pcb);
+      removeProcess(core, core->runningProcess);
+      core->runningProcess = NULL;
+      core->quantum = 0;
+    }
+  }
+
+  // load the newly arrived processes into the timeline, new ones
+  // start at the least virtual runtime and stolen ones keep their lead
+  processInfo = &info;
+  while (popFront(core->arrived, (void **)&processInfo)) {
+    pcb = processTable[processInfo->id];
+    pcb->vruntime += core->minVruntime;
+    core->weight += weightOf(pcb);
+    insertRB(core->timeline, pcb->vruntime, pcb->id, 0, processInfo);
+  }
 
-int nextFitBM(PCB* process){
-  for (int i = lastAllocated; i < MEMORY_SIZE; i++) {
-    if (checkAllocateBM(i, process->memsize)) {
-      processTable[process->memsize]->memstart = i;
-      allocateBM(i, process->memsize);
-      lastAllocated = i + process->memsize;
-      return i;
+  // once its slice is over the running process makes way for the one
+  // that ran the least, or gets another slice if that's still itself
+  if (core->runningProcess != NULL && !core->quantum && !core->stalled) {
+    pcb = processTable[core->runningProcess->id];
+    RBNode *first = firstRB(core->timeline);
+    if (first != NULL && first->key < pcb->vruntime) {
+      stopProcess(core, core->runningProcess);
+      insertRB(core->timeline, pcb->vruntime, pcb->id, 0,
+               core->runningProcess);
+      core->runningProcess = NULL;
+    } else {
+      core->slice = sliceOf(core, pcb);
     }
   }
-  return -1;
-}
 
-bool checkAllocateBM(int start, int size) {
-  for (int i = 0; i < size; i++) {
-    if (bitMap[(start + i) % MEMORY_SIZE]) {
+  // the next process is the one with the least virtual runtime
+  if (core->runningProcess == NULL) {
+    RBNode *first = firstRB(core->timeline);
+    if (first == NULL) {
       return false;
     }
+    core->current = *(ProcessInfo *)first->data;
+    core->runningProcess = &core->current;
+    removeRB(core->timeline, first);
+    core->slice = sliceOf(core, processTable[core->current.id]);
+    contProcess(core, core->runningProcess);
+  }
+
+  // the running process runs for a tick, the time it
+  // waits to be swapped in doesn't use up its slice
+  core->stalled = !runProcess(core->runningProcess);
+  if (core->stalled) {
+    return false;
+  }
+  pcb = processTable[core->runningProcess->id];
+  pcb->vruntime += CFS_SCALE / weightOf(pcb);
+  updateMinVruntime(core);
+  core->quantum += 1;
+  if (core->quantum >= core->slice) {
+    core->quantum = 0;
   }
   return true;
 }
 
-void allocateBM(int start, int size) {
-  for (int i = 0; i < size; i++) {
-    bitMap[(start + i) % MEMORY_SIZE] = true;
+/*
+ * Returns the weight of a process by its priority.
+ */
+long weightOf(PCB *pcb) {
+  int priority = pcb->priority < 0 ? 0 : pcb->priority;
+  return cfsWeights[priority < CFS_PRIORITIES ? priority
+                                              : CFS_PRIORITIES - 1];
+}
+
+/*
+ * Returns the ticks a process gets to run for once it starts, its
+ * share of the target latency by its weight out of the total weight
+ * of the processes on its core, but no less than the minimum.
+ */
+int sliceOf(Core *core, PCB *pcb) {
+  long slice = options.targetLatency * weightOf(pcb) / core->weight;
+  return slice > options.minGranularity ? slice : options.minGranularity;
+}
+
+/*
+ * Moves the least virtual runtime of a core up to the one of its
+ * running process or the first one in its timeline, if that's less.
+ */
+void updateMinVruntime(Core *core) {
+  long least = processTable[core->runningProcess->id]->vruntime;
+  RBNode *first = firstRB(core->timeline);
+  if (first != NULL && first->key < least) {
+    least = first->key;
+  }
+  if (least > core->minVruntime) {
+    core->minVruntime = least;
   }
 }
 
-void deallocateBM(int start, int size) {
-  for (int i = 0; i < size; i++) {
-    bitMap[(start + i) % MEMORY_SIZE] = false;
+/*
+ * Returns the number of processes a core has, running or not.
+ */
+int coreLoad(Core *core) {
+  int load = core->arrived->length;
+  if (core->deque != NULL) {
+    load += core->deque->length;
+  }
+  if (core->priorityQueue != NULL) {
+    load += core->priorityQueue->length;
+  }
+  if (core->circularQueue != NULL) {
+    load += core->circularQueue->length;
+  }
+  // the running process isn't on any of the levels
+  if (core->levels != NULL) {
+    unsigned long levels = core->nonEmpty;
+    while (levels) {
+      load += core->levels[__builtin_ctzl(levels)]->length;
+      levels &= levels - 1;
+    }
+    load += core->runningProcess != NULL;
+  }
+  if (core->timeline != NULL) {
+    load += core->timeline->length + (core->runningProcess != NULL);
   }
+  return load;
 }
 
-int firstFit(PCB* process) {
-  Node *node = memoryHead;
-  for (int i = 0; i < memory->length; ++i) {
-    MemoryNode *memoryNode = (MemoryNode *)node->data;
-    if (memoryNode->size >= process->memsize && memoryNode->process == 0) {
-      if(allocate(memoryNode->start, process->memsize, process->id)) {
-        return memoryNode->start;
+/*
+ * Returns the number of processes in the run queue
+ * of a core that aren't running.
+ */
+int queuedOn(Core *core) {
+  return coreLoad(core) - core->arrived->length -
+         (core->runningProcess != NULL);
+}
+
+/*
+ * Hands the processes that got memory to the cores, each one
+ * goes to the core with the fewest processes so they stay even.
+ */
+void assignArrivals() {
+  ProcessInfo info;
+  ProcessInfo *processInfo = &info;
+  while (popFront(arrived, (void **)&processInfo)) {
+    Core *core = &cores[0];
+    for (int i = 1; i < options.cores; ++i) {
+      if (coreLoad(&cores[i]) < coreLoad(core)) {
+        core = &cores[i];
       }
     }
-    node = node->next;
+    processTable[processInfo->id]->waitingSince = tick;
+    pushBack(core->arrived, processInfo);
   }
-  return -1;
 }
 
-int nextFit(PCB* process) {
-  Node *node = memoryLast;
-  for (int i = 0; i < memory->length; ++i) {
-    MemoryNode *memoryNode = (MemoryNode *)node->data;
-    if (memoryNode->size >= process->memsize && memoryNode->process == 0) {
-      if(allocate(memoryNode->start, process->memsize, process->id)) {
-        return memoryNode->start;
+/*
+ * Lets every idle core take one process that isn't running from the
+ * core with the most of them. It comes from the end of the run queue,
+ * so the process that core runs next stays where it is.
+ */
+void stealWork() {
+  for (int i = 0; i < options.cores; ++i) {
+    if (coreLoad(&cores[i])) {
+      continue;
+    }
+    Core *busiest = NULL;
+    for (int j = 0; j < options.cores; ++j) {
+      if (queuedOn(&cores[j]) &&
+          (busiest == NULL || queuedOn(&cores[j]) > queuedOn(busiest))) {
+        busiest = &cores[j];
       }
     }
-    node = node->next;
+    if (busiest == NULL) {
+      return;
+    }
+
+    ProcessInfo info;
+    ProcessInfo *processInfo = &info;
+    if (busiest->deque != NULL) {
+      popBack(busiest->deque, (void **)&processInfo);
+    } else if (busiest->priorityQueue != NULL) {
+      PriorityQueue *queue = busiest->priorityQueue;
+      info = *(ProcessInfo *)queue->nodes[queue->length - 1].data;
+      removeAtPQ(queue, queue->length - 1);
+    } else if (busiest->circularQueue != NULL) {
+      info = *(ProcessInfo *)borrowPrev(busiest->circularQueue);
+      removeCQ(busiest->circularQueue);
+    } else if (busiest->levels != NULL) {
+      // the lowest level has the processes that ran the longest
+      int level = WORD_BITS - 1 - __builtin_clzl(busiest->nonEmpty);
+      popBack(busiest->levels[level], (void **)&processInfo);
+      if (!busiest->levels[level]->length) {
+        busiest->nonEmpty &= ~(1ul << level);
+      }
+    } else {
+      // the process that would run last, its lead over the
+      // others stays the same on the core it goes to
+      RBNode *last = lastRB(busiest->timeline);
+      info = *(ProcessInfo *)last->data;
+      removeRB(busiest->timeline, last);
+      PCB *pcb = processTable[info.id];
+      pcb->vruntime -= busiest->minVruntime;
+      busiest->weight -= weightOf(pcb);
+    }
+    pushBack(cores[i].arrived, processInfo);
+  }
+}
+
+/*
+ * Returns the next tick the scheduler has to run at.
+ * As long as anything is resident or ready every tick counts,
+ * and waiting processes still collect wait time while more
+ * arrivals can come and get resident, otherwise nothing can
+ * happen until the next arrival.
+ */
+int nextEvent() {
+  bool ready = arrived->length;
+  for (int i = 0; i < options.cores; ++i) {
+    ready = ready || coreLoad(&cores[i]);
+  }
+  if (ready) {
+    return tick + 1;
+  }
+  if (waitingLength && sharedClock->next[GENERATOR] != INT_MAX) {
+    return tick + 1;
+  }
+  if (waitingLength && compactedUntil) {
+    return compactedUntil;
   }
-  return -1;
+  return INT_MAX;
 }
 
-int bestFit(PCB* process){
-  int minsize = MEMORY_SIZE+1;
-  int start = -1;
+/*
+ * Returns the next tick a tickless scheduler has something to decide
+ * in. That is the next arrival, a running process finishing or using
+ * up its quantum, or compaction starting or ending. Until then the
+ * running processes just keep running, and nothing else can change.
+ * A process waiting to be swapped in, processes that just got memory,
+ * or an idle core that can steal a process need the next tick.
+ */
+int nextDecision() {
+  int next = sharedClock->next[GENERATOR];
+  bool running = false;
+  bool idle = false;
+  bool queued = false;
+  skipUntil = 0;
+  if (arrived->length) {
+    return tick + 1;
+  }
 
-  MemoryNode *memoryNode = NULL;
-  for (int i = 0; i < memory->length; ++i) {
-    peekCQ(memory, (void **)&memoryNode);
-    if (memoryNode->size >= process->memsize && !memoryNode->process) {
-      if (minsize >= memoryNode->size) {
-        minsize = memoryNode->size;
-        start = memoryNode->start;
+  for (int i = 0; i < options.cores; ++i) {
+    Core *core = &cores[i];
+    idle = idle || !coreLoad(core);
+    queued = queued || queuedOn(core);
+    if (core->arrived->length ||
+        (core->runningProcess == NULL && coreLoad(core))) {
+      return tick + 1;
+    }
+    if (core->runningProcess == NULL) {
+      continue;
+    }
+
+    running = true;
+    PCB *pcb = processTable[core->runningProcess->id];
+    if (pcb->memstart == -1 || tick < pcb->swapUntil) {
+      return tick + 1;
+    }
+    // it's removed on the tick after its last one
+    if (tick + pcb->remain + 1 < next) {
+      next = tick + pcb->remain + 1;
+    }
+    int quantumEnd = tick + (QUANTA - core->quantum) % QUANTA + 1;
+    if (sch == MLFQ) {
+      quantumEnd = core->quantum
+                       ? tick + options.quanta[pcb->level] - core->quantum + 1
+                       : tick + 1;
+      // a boost can let a process on another level take over
+      int period = options.boostPeriod;
+      if (period && (tick / period + 1) * period < quantumEnd) {
+        quantumEnd = (tick / period + 1) * period;
       }
     }
+    if (sch == CFS) {
+      quantumEnd = core->quantum ? tick + core->slice - core->quantum + 1
+                                 : tick + 1;
+    }
+    if ((sch == RR || sch == MLFQ || sch == CFS) && quantumEnd < next) {
+      next = quantumEnd;
+    }
+  }
+  if (idle && queued) {
+    return tick + 1;
   }
-  free(memoryNode);
 
-  if (allocate(start, process->memsize, process->id) ) {
-    return start;
+  // periodic compaction goes by the ticks the scheduler would have
+  // run in otherwise, waiters only wait for compaction to end
+  bool ticking = running ||
+                 (waitingLength && sharedClock->next[GENERATOR] != INT_MAX);
+  if (options.compactPeriod && ticking && nextCompaction < next) {
+    next = nextCompaction > tick ? nextCompaction : tick + 1;
+  }
+  if (compactedUntil && compactedUntil < next) {
+    next = compactedUntil > tick ? compactedUntil : tick + 1;
   }
 
-  return -1;
+  if (running) {
+    lastDecision = tick;
+    skipUntil = next;
+  }
+  return next;
 }
 
+/*
+ * Runs the running processes for the ticks a tickless scheduler skipped
+ * since its last decision, at most up to the tick it planned to wake
+ * up at in case a real clock moved on further than that.
+ */
+void runSkipped() {
+  int end = tick < skipUntil ? tick : skipUntil;
+  int ticks = end - lastDecision - 1;
+  skipUntil = 0;
+  if (ticks <= 0) {
+    return;
+  }
 
-int buddy(PCB* process){
-  return 1;
+  for (int i = 0; i < options.cores; ++i) {
+    Core *core = &cores[i];
+    if (core->runningProcess == NULL) {
+      continue;
+    }
+    PCB *pcb = processTable[core->runningProcess->id];
+    core->utilization += ticks;
+    if (sch == RR) {
+      core->quantum = (core->quantum + ticks) % QUANTA;
+    }
+    if (sch == MLFQ) {
+      core->quantum += ticks;
+      if (core->quantum >= options.quanta[pcb->level]) {
+        core->quantum = 0;
+        if (pcb->level < options.levels - 1) {
+          pcb->level += 1;
+        }
+      }
+    }
+    if (sch == CFS) {
+      pcb->vruntime += ticks * (CFS_SCALE / weightOf(pcb));
+      updateMinVruntime(core);
+      core->quantum += ticks;
+      if (core->quantum >= core->slice) {
+        core->quantum = 0;
+      }
+    }
+    if (mem == PAGING) {
+      // every access depends on how long the process ran
+      for (int j = 0; j < ticks; ++j) {
+        pcb->remain -= 1;
+        pcb->execution += 1;
+        touchPages(core, pcb);
+      }
+    } else {
+      pcb->remain -= ticks;
+      pcb->execution += ticks;
+    }
+  }
 }
 
-int ceilPowerOfTwo(int num) {
-  num--;
-  num |= num >> 1;
-  num |= num >> 2;
-  num |= num >> 4;
-  num |= num >> 8;
-  num |= num >> 16;
-  return ++num;
+long firstFitBM(PCB* process){
+  // initialize the bit map if it's not initialized
+  if (bitMap == NULL) {
+    bitMap = newBitMap(memoryUnits);
+  }
+
+  long units = unitsOf(process);
+  long start = fitBM(bitMap, 0, units);
+  if (start != -1) {
+    markBM(bitMap, start, units, true);
+  }
+  return start;
+}
+
+long nextFitBM(PCB* process){
+  if (bitMap == NULL) {
+    bitMap = newBitMap(memoryUnits);
+  }
+
+  // the first free run that fits going around the
+  // memory from the end of the last allocated block
+  long units = unitsOf(process);
+  long start = fitBM(bitMap, lastAllocated, units);
+  if (start == -1) {
+    start = fitBM(bitMap, 0, units);
+  }
+  if (start != -1) {
+    markBM(bitMap, start, units, true);
+    lastAllocated = start + units;
+  }
+  return start;
+}
+
+void unfitBM(PCB* process){
+  markBM(bitMap, process->memstart, unitsOf(process), false);
+}
+
+long firstFit(PCB* process) {
+  // the hole block with the lowest start that fits
+  long units = unitsOf(process);
+  RBNode *hole = fitRB(freeByStart, 0, units);
+  if (hole == NULL) {
+    return -1;
+  }
+  long start = hole->key;
+  allocate(*(Node **)hole->data, units, process->id);
+  return start;
+}
+
+long nextFit(PCB* process) {
+  // the first hole block that fits going around
+  // the memory from the last allocated block
+  long units = unitsOf(process);
+  long last = ((MemoryNode *)memoryLast->data)->start;
+  RBNode *hole = fitRB(freeByStart, last, units);
+  if (hole == NULL) {
+    hole = fitRB(freeByStart, 0, units);
+  }
+  if (hole == NULL) {
+    return -1;
+  }
+  long start = hole->key;
+  allocate(*(Node **)hole->data, units, process->id);
+  return start;
+}
+
+long bestFit(PCB* process){
+  // the smallest hole that fits, the lowest
+  // start breaks ties between holes of equal size
+  long units = unitsOf(process);
+  RBNode *hole = ceilingRB(freeBySize, units, 0);
+  if (hole == NULL) {
+    return -1;
+  }
+  long start = hole->tie;
+  allocate(*(Node **)hole->data, units, process->id);
+  return start;
+}
+
+
+long buddy(PCB* process){
+  // initialize the buddy system if it's not initialized
+  if (buddies == NULL) {
+    buddies = newBuddy(memoryUnits);
+  }
+
+  // the whole block is reserved even if
+  // the process only needs part of it
+  return allocateBuddy(buddies, unitsOf(process));
+}
+
+void unbuddy(PCB* process){
+  freeBuddy(buddies, process->memstart, unitsOf(process));
+}
+
+long page(PCB* process){
+  // initialize the frames and the tlbs if they're not initialized
+  if (frames == NULL) {
+    frames = newFrames(memoryUnits);
+    for (int i = 0; i < options.cores; ++i) {
+      cores[i].tlb = newTLB(options.tlbSize);
+    }
+  }
+
+  long pages = unitsOf(process);
+  if (freeFrames(frames) < pages) {
+    return -1;
+  }
+  process->pageTable = (long *)malloc(pages * sizeof(long));
+  takeFrames(frames, process->pageTable, pages);
+  return process->pageTable[0];
+}
+
+void unpage(PCB* process){
+  giveFrames(frames, process->pageTable, unitsOf(process));
+  for (int i = 0; i < options.cores; ++i) {
+    flushTLB(cores[i].tlb, process->id);
+  }
+  free(process->pageTable);
+  process->pageTable = NULL;
+}
+
+/*
+ * Writes a line to memory.log for every run of consecutive frames
+ * in the page table of a process, with the bytes of it in the run.
+ */
+void logFrames(char *action, PCB *pcb) {
+  long pages = unitsOf(pcb);
+  long left = pcb->memsize;
+  long first = 0;
+  for (long i = 1; i <= pages; ++i) {
+    if (i == pages || pcb->pageTable[i] != pcb->pageTable[i - 1] + 1) {
+      long units = i - first;
+      long bytes = units * options.granularity;
+      if (bytes > left) {
+        bytes = left;
+      }
+      logMemory(action, bytes, pcb->id, pcb->pageTable[first], units);
+      left -= bytes;
+      first = i;
+    }
+  }
+}
+
+/*
+ * Goes through the memory accesses the running process makes in a
+ * tick, it mostly stays at the page it's at, moves on to the next one
+ * about once a tick and sometimes jumps to a random page. Every access
+ * goes through the TLB of the core it runs on. The pages only depend
+ * on the process and how long it ran.
+ */
+void touchPages(Core *core, PCB *pcb) {
+  long pages = unitsOf(pcb);
+  for (int i = 0; i < PAGE_ACCESSES; ++i) {
+    unsigned long step = (unsigned long)pcb->execution * PAGE_ACCESSES + i;
+    unsigned long hash = (((unsigned long)pcb->id << 32) ^ step) *
+                         0x9E3779B97F4A7C15ul;
+    hash ^= hash >> 29;
+    if (hash % PAGE_JUMP == 0) {
+      pcb->cursor = (hash >> 8) % pages;
+    } else {
+      pcb->cursor = (pcb->cursor + !((hash >> 8) % PAGE_ACCESSES)) % pages;
+    }
+    lookupTLB(core->tlb, pcb->id, pcb->cursor);
+  }
 }
 
 void clearResources(int signum) {
@@ -1017,25 +2227,68 @@ void clearResources(int signum) {
     if (memory != NULL) {
       deleteCircularQueue(memory);
     }
+    if (buddies != NULL) {
+      deleteBuddy(buddies);
+    }
+    if (bitMap != NULL) {
+      deleteBitMap(bitMap);
+    }
+    if (frames != NULL) {
+      deleteFrames(frames);
+    }
+    if (freeBySize != NULL) {
+      deleteRBTree(freeBySize);
+      deleteRBTree(freeByStart);
+    }
+    if (blocks != NULL) {
+      deleteHashMap(blocks);
+    }
     if (arrived != NULL) {
       deleteDeque(arrived);
     }
-    if (waiting != NULL) {
-      deleteDeque(waiting);
+    if (residents != NULL) {
+      deleteDeque(residents);
     }
-    if (deque != NULL) {
-      deleteDeque(deque);
-    }
-    if (priorityQueue != NULL) {
-      deletePriorityQueue(priorityQueue);
+    for (int i = 0; i < WAITING_BUCKETS; ++i) {
+      if (waiting[i] != NULL) {
+        deleteDeque(waiting[i]);
+      }
     }
-    if (circularQueue != NULL) {
-      deleteCircularQueue(circularQueue);
+    for (int i = 0; cores != NULL && i < options.cores; ++i) {
+      deleteDeque(cores[i].arrived);
+      if (cores[i].deque != NULL) {
+        deleteDeque(cores[i].deque);
+      }
+      if (cores[i].priorityQueue != NULL) {
+        deletePriorityQueue(cores[i].priorityQueue);
+      }
+      if (cores[i].circularQueue != NULL) {
+        deleteCircularQueue(cores[i].circularQueue);
+      }
+      if (cores[i].tlb != NULL) {
+        deleteTLB(cores[i].tlb);
+      }
+      for (int j = 0; cores[i].levels != NULL && j < options.levels; ++j) {
+        deleteDeque(cores[i].levels[j]);
+      }
+      free(cores[i].levels);
+      if (cores[i].timeline != NULL) {
+        deleteRBTree(cores[i].timeline);
+      }
     }
+    free(cores);
     if (processTable != NULL) {
       free(processTable);
     }
-    semctl(bufsemid, 0, IPC_RMID);
+    clearPool(&pcbs);
+    if (idleWorkers != NULL) {
+      deleteDeque(idleWorkers);
+    }
+    for (int i = 0; i * WORKER_CHUNK_SIZE < workerCount; ++i) {
+      shmctl(workerChunkIds[i], IPC_RMID, (struct shmid_ds *)0);
+    }
+    free(workerChunkIds);
+    free(workers);
     shmdt(bufferaddr);
     destroyClk(false);
   }